@@ -5,18 +5,60 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
 
 #include "Libs/Shader.h"
 #include "Libs/Window.h"
 #include "Libs/Mesh.h"
 #include "Libs/stb_image.h"
 #include "Libs/Model.h"
+#include "Libs/Frustum.h"
+#include "Libs/SceneBVH.h"
+#include "Libs/OcclusionCuller.h"
+#include "Libs/HiZCuller.h"
+#include "Libs/MultiDrawIndirect.h"
+#include "Libs/OcclusionQueries.h"
+#include "Libs/CellPortals.h"
+#include "Libs/PotentiallyVisibleSet.h"
+#include "Libs/AssetRegistry.h"
+#include "Libs/FrameUniforms.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 const GLint WIDTH = 800, HEIGHT = 600;
+const unsigned int OBJ_PARSE_THREADS = 0; // 0 = one per hardware thread
+const bool USE_MESH_CACHE = true;
+const bool OPTIMIZE_VERTEX_CACHE = true;
+const float OVERDRAW_THRESHOLD = 1.05f; // allowed ACMR growth when reordering for overdraw, 0 = off
+const bool COMPACT_VERTICES = false; // quantised positions/UVs/normals and 16-bit indices
+// triangle ratio and largest error (fraction of the model's extent) of each generated LOD, empty = no LODs
+const std::vector<LodTarget> LOD_TARGETS = {{0.5f, 0.01f}, {0.25f, 0.02f}, {0.1f, 0.05f}};
+const float LOD_PIXEL_ERROR = 1.0f; // largest simplification error allowed on screen, in pixels
+const float LOD_BIAS = 0.0f; // each +1 doubles the allowed pixel error (coarser LODs), -1 halves it
+const float LOD_HYSTERESIS = 0.25f; // a level must beat the budget by this fraction before switching
+const bool FRUSTUM_CULLING = true; // skip models whose world-space box is outside the view frustum
+const bool SCENE_BVH = true; // answer frustum, picking and collision queries from a BVH over the models
+const bool CAMERA_COLLISION = true; // stop the camera from entering a model's bounding box
+const float CAMERA_RADIUS = 0.2f;
+const bool PVS_CULLING = true; // skip models outside the camera cell's baked visible set, made by pvs-bake
+const char *PVS_FILE = "Models/classroom.pvs";
+const bool PORTAL_CULLING = true; // only consider models visible through the classroom's doors and windows
+const char *PORTAL_FILE = "Models/anime-school.portals";
+const bool OCCLUSION_CULLING = true; // skip models hidden behind occluder models, tested on the CPU
+const int OCCLUSION_BUFFER_WIDTH = 256; // occlusion depth buffer width, height follows the window aspect
+const unsigned int OCCLUSION_THREADS = 0; // occlusion rasteriser threads, 0 = one per hardware thread
+const float OCCLUDER_MAX_ERROR = 0.0f; // coarsest LOD error allowed for occluders, 0 = full mesh
+const bool HIZ_CULLING = true; // GPU Hi-Z occlusion culling when an OpenGL 4.3 context is available, H toggles it
+const bool MULTI_DRAW_INDIRECT = true; // one glMultiDrawElementsIndirect for the scene when Hi-Z is off, on OpenGL 4.3 with ARB_shader_draw_parameters
+const bool OCCLUSION_QUERIES = true; // conditional rendering on box occlusion queries for models that opt in
+const int DOGE_INSTANCE_GRID = 0; // also place an N x N grid of doges beside the classroom, drawn instanced, 0 = off
+const bool MESHLET_CULLING = true; // skip meshlets outside the view frustum
+const bool MESHLET_CONE_CULLING = false; // also skip back-facing meshlets; only safe for closed, consistently wound models
+const float FRAME_STATS_INTERVAL = 1.0f; // seconds between culling stats printouts, 0 = off
 
 Window mainWindow;
 std::vector<Mesh *> meshList;
@@ -26,6 +68,11 @@ std::vector<Model> models;
 std::vector<glm::vec3> modelPositions;
 std::vector<unsigned int> modelTextures;
 std::vector<float> modelScales;
+std::vector<unsigned int> modelLods;
+std::vector<unsigned char> modelOcclusionQueries;
+// per-instance placements of instanced models, nullptr for models drawn once
+std::vector<InstanceBuffer *> modelInstances;
+SceneBVH sceneBvh;
 
 float yaw = -90.0f, pitch = 0.0f;
 float deltaTime, lastFrame;
@@ -39,13 +86,14 @@ static const char *fShader = "Shaders/shader.frag";
 
 /**
  * Function to create a Mesh object from an OBJ file and add it to the meshList.
+ * Models loading the same OBJ share one Mesh.
  * @param path The path to the OBJ file.
+ * @param occluder Whether to keep a CPU copy of the mesh for the occlusion culler.
  */
-void CreateOBJ(char const *path) {
-    Mesh *obj1 = new Mesh();
+void CreateOBJ(char const *path, bool occluder) {
     std::cout << "(ノಠ益ಠ)ノ彡┻━┻ Loading model " << path << std::endl;
-    bool loaded = obj1->CreateMeshFromOBJ(path);
-    if (loaded) {
+    Mesh *obj1 = AssetRegistry::Get().AcquireMesh(path, occluder);
+    if (obj1 != nullptr) {
         meshList.push_back(obj1);
         std::cout << "Model loaded" << std::endl;
     } else {
@@ -134,45 +182,13 @@ void checkKeyboard(glm::vec3 &cameraPosition, glm::vec3 &cameraDirection, glm::v
 }
 
 /**
- * Function to load a texture from a file.
+ * Function to load a texture from a file. Textures already loaded from the same file are shared.
  * @param path The path to the texture file.
  * @param isFlipped Whether the texture should be flipped vertically.
  * @return The ID of the loaded texture.
  */
 unsigned int loadTexture(char const *path, bool isFlipped = true) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    std::cout << "Loading texture " << path << std::endl;
-
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(isFlipped);
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLint format;
-        // set format based on number of channels
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        std::cout << "Texture loaded" << std::endl;
-    } else {
-        std::cout << "Failed to load " << path << std::endl;
-    }
-    stbi_image_free(data);
-
-    return textureID;
+    return AssetRegistry::Get().AcquireTexture(path, isFlipped);
 }
 
 /**
@@ -181,31 +197,157 @@ unsigned int loadTexture(char const *path, bool isFlipped = true) {
  */
 void loadModel(const Model &model) {
     std::cout << "========================================" << std::endl;
-    CreateOBJ(model.modelPath.c_str());
+    CreateOBJ(model.modelPath.c_str(), model.occluder);
     modelTextures.push_back(loadTexture(model.texturePath.c_str(), model.flipTexture));
     modelPositions.push_back(model.position);
     modelScales.push_back(model.scale);
+    modelLods.push_back(0);
+    modelOcclusionQueries.push_back(model.occlusionQuery);
+    modelInstances.push_back(model.instances.empty() ? nullptr : new InstanceBuffer(model.instances));
     std::cout << "========================================" << std::endl;
 }
 
+/**
+ * Function to build the model matrix of a loaded model, including its animation.
+ * @param i Index of the model in meshList.
+ * @param time Seconds since start, drives the animations.
+ * @return The model matrix.
+ */
+glm::mat4 getModelMatrix(int i, float time) {
+    glm::mat4 model(1.0f);
+    model = glm::translate(model, modelPositions[i]);
+    model = glm::scale(model, glm::vec3(modelScales[i]));
+
+    if (i == 2) {
+        // jump animation for TheCat
+        float jumpHeight = 8.0f;
+        float jumpSpeed = 10.0f;
+        float jump = sin(time * jumpSpeed) * jumpHeight;
+        model = glm::translate(model, glm::vec3(0.0f, jump, 0.0f));
+    } else if (i == 4) {
+        // rotate CatBanana
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    } else if (i == 5) {
+        // rotate deal-with-it-doge
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    } else if (i == 6) {
+        // rotate SaulGoodman
+        model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    } else if (i == 8) {
+        // rotate ace
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    }
+    return model;
+}
+
+/**
+ * Function to keep the camera out of the models. A move is undone if it makes the camera
+ * overlap a box it was not already inside, so it can still leave the classroom's box.
+ * @param oldPosition Camera position before this frame's movement.
+ * @param cameraPosition Camera position after the movement, reset on collision.
+ * @param worldBounds World-space bounds the BVH was last built or refitted with.
+ */
+void resolveCameraCollision(const glm::vec3 &oldPosition, glm::vec3 &cameraPosition, const std::vector<Bounds> &worldBounds) {
+    static std::vector<unsigned int> overlapping;
+    sceneBvh.QuerySphere(cameraPosition, CAMERA_RADIUS, overlapping);
+    auto blocks = [&](const Bounds &bounds) {
+        glm::vec3 closest = glm::clamp(oldPosition, bounds.boxMin, bounds.boxMax);
+        return glm::length(closest - oldPosition) > CAMERA_RADIUS;
+    };
+    for (unsigned int object : overlapping) {
+        if (object < modelInstances.size() && modelInstances[object] != nullptr) {
+            // the box around all the instances is mostly empty, so test each instance's own
+            for (const Bounds &bounds : modelInstances[object]->GetInstanceBounds()) {
+                glm::vec3 closest = glm::clamp(cameraPosition, bounds.boxMin, bounds.boxMax);
+                if (glm::length(closest - cameraPosition) <= CAMERA_RADIUS && blocks(bounds)) {
+                    cameraPosition = oldPosition;
+                    return;
+                }
+            }
+        } else if (blocks(worldBounds[object])) {
+            cameraPosition = oldPosition;
+            return;
+        }
+    }
+}
+
+/**
+ * Function to pick the coarsest LOD whose simplification error projects to at most
+ * LOD_PIXEL_ERROR pixels, with hysteresis so models near a switch distance do not flicker.
+ * @param mesh The mesh whose LOD chain to choose from.
+ * @param worldError World-space size of an error of 1.0, i.e. the model's extent times its scale.
+ * @param distance Distance from the camera to the nearest point of the model's bounding sphere.
+ * @param pixelsPerUnit Pixels covered by one world unit at distance 1.
+ * @param current The level drawn last frame.
+ * @return The level to draw this frame.
+ */
+unsigned int selectLod(const Mesh &mesh, float worldError, float distance, float pixelsPerUnit, unsigned int current) {
+    if (mesh.GetLodCount() == 0) {
+        return 0;
+    }
+    float budget = LOD_PIXEL_ERROR * std::exp2(LOD_BIAS);
+    auto projectedError = [&](unsigned int lod) {
+        return mesh.GetLod(lod).error * worldError * pixelsPerUnit / distance;
+    };
+    auto coarsestWithin = [&](float limit) {
+        unsigned int lod = 0;
+        while (lod + 1 < mesh.GetLodCount() && projectedError(lod + 1) <= limit) {
+            lod++;
+        }
+        return lod;
+    };
+
+    current = std::min(current, mesh.GetLodCount() - 1);
+    if (projectedError(current) > budget * (1.0f + LOD_HYSTERESIS)) {
+        return coarsestWithin(budget);
+    }
+    return std::max(current, coarsestWithin(budget * (1.0f - LOD_HYSTERESIS)));
+}
+
 int main() {
-    mainWindow = Window(WIDTH, HEIGHT, 3, 3, "My Precious Moment");
+    // Hi-Z culling needs compute shaders; the window falls back to 3.3 without them
+    mainWindow = Window(WIDTH, HEIGHT, HIZ_CULLING || MULTI_DRAW_INDIRECT ? 4 : 3, 3, "My Precious Moment");
     mainWindow.initialise();
+    MeshLoadOptions loadOptions;
+    loadOptions.parseThreads = OBJ_PARSE_THREADS;
+    loadOptions.useCache = USE_MESH_CACHE;
+    loadOptions.optimizeVertexCache = OPTIMIZE_VERTEX_CACHE;
+    loadOptions.overdrawThreshold = OVERDRAW_THRESHOLD;
+    loadOptions.compactVertices = COMPACT_VERTICES;
+    loadOptions.buildMeshlets = MESHLET_CULLING;
+    loadOptions.lodTargets = LOD_TARGETS;
+    loadOptions.occluderMaxError = OCCLUDER_MAX_ERROR;
+    Mesh::SetLoadOptions(loadOptions);
 
     // add models to the models vector
-    models.push_back({"Models/anime-school.obj", "Textures/anime-school/bg.jpg", glm::vec3(0.0f)});
+    models.push_back({"Models/anime-school.obj", "Textures/anime-school/bg.jpg", glm::vec3(0.0f), 1.0f, true, OCCLUSION_CULLING, true});
     models.push_back({"Models/shiba.obj", "Textures/shiba.png", glm::vec3(1.0f, 1.8f, 7.3f), 50.0f});
-    models.push_back({"Models/TheCat.obj", "Textures/TheCat.png", glm::vec3(-2.3f, 0.5f, 5.8f), 0.02f});
-    models.push_back({"Models/CatPlushie.obj", "Textures/CatPlushie.png", glm::vec3(3.7f, 1.3f, 10.8f), 8.0f});
+    models.push_back({"Models/TheCat.obj", "Textures/TheCat.png", glm::vec3(-2.3f, 0.5f, 5.8f), 0.02f, true, false, true});
+    models.push_back({"Models/CatPlushie.obj", "Textures/CatPlushie.png", glm::vec3(3.7f, 1.3f, 10.8f), 8.0f, true, false, true});
     models.push_back({"Models/CatBanana.obj", "Textures/CatBanana.png", glm::vec3(-0.8f, -0.4f, 8.8f), 0.8f});
     models.push_back({"Models/deal-with-it-doge.obj", "Textures/deal-with-it-doge.png", glm::vec3(-3.3f, 1.4f, 14.0f), 20.0f});
     models.push_back({"Models/SaulGoodman.obj", "Textures/SaulGoodman.png", glm::vec3(-2.4f, -0.25f, 16.5f), 0.02f});
     models.push_back({"Models/merry.obj", "Textures/merry.png", glm::vec3(11.0f, 3.3f, 10.5f), 1.0f});
     models.push_back({"Models/ace.obj", "Textures/ace.png", glm::vec3(-0.3f, 0.7f, 13.0f), 17.0f});
+    if (DOGE_INSTANCE_GRID > 0) {
+        // the doge where it was, then the grid
+        std::vector<glm::mat4> &doges = models[5].instances;
+        doges.push_back(glm::mat4(1.0f));
+        for (int x = 0; x < DOGE_INSTANCE_GRID; x++) {
+            for (int z = 0; z < DOGE_INSTANCE_GRID; z++) {
+                doges.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(20.0f + x * 2.0f, 0.0f, z * -2.0f)));
+            }
+        }
+    }
 
     CreateShaders();
-
-    GLuint uniformModel = 0, uniformProjection = 0, uniformView = 0;
+    InstanceBuffer::SetIdentity();
+    FrameUniforms frameUniforms;
+    frameUniforms.Initialise();
+    FrameUniforms::BindBlocks(shaderList[0]);
+    FrameBlock frameBlock;
+    std::vector<DrawBlock> drawBlocks;
 
     glm::vec3 cameraPosition = glm::vec3(0.0f, 4.0f, 16.0f);
     glm::vec3 cameraTarget = glm::vec3(0.0f);
@@ -218,6 +360,37 @@ int main() {
     glm::mat4 projection = glm::perspective(45.0f, (GLfloat) mainWindow.getBufferWidth() / (GLfloat) mainWindow.getBufferHeight(), 0.1f, 500.0f);
 
     int currentModel = 0;
+    float lastStatsTime = 0.0f;
+    std::vector<glm::mat4> modelMatrices;
+    std::vector<Bounds> worldBounds;
+    std::vector<unsigned char> modelVisible;
+    BoxList worldBoxes;
+    OcclusionCuller occlusionCuller(OCCLUSION_BUFFER_WIDTH,
+                                    OCCLUSION_BUFFER_WIDTH * mainWindow.getBufferHeight() / std::max(mainWindow.getBufferWidth(), 1),
+                                    OCCLUSION_CULLING ? OCCLUSION_THREADS : 1);
+    bool mouseWasDown = false;
+    HiZCuller hiZCuller;
+    bool hiZEnabled = HIZ_CULLING && hiZCuller.Initialise(mainWindow.getBufferWidth(), mainWindow.getBufferHeight());
+    bool hiZKeyWasDown = false;
+    MultiDrawIndirect multiDraw;
+    bool multiDrawEnabled = MULTI_DRAW_INDIRECT && multiDraw.Initialise();
+    MultiDrawStats multiDrawStats;
+    OcclusionQueries occlusionQueries;
+    if (OCCLUSION_QUERIES) {
+        occlusionQueries.Initialise();
+    }
+    std::vector<unsigned char> modelQueried;
+    CellPortalGraph cellPortals;
+    if (PORTAL_CULLING && !cellPortals.Load(PORTAL_FILE)) {
+        std::cout << "No cells and portals loaded from " << PORTAL_FILE << ", portal culling is off" << std::endl;
+    }
+    PortalStats portalStats;
+    PotentiallyVisibleSet visibleSet;
+    if (PVS_CULLING && !visibleSet.Load(PVS_FILE, static_cast<uint32_t>(models.size()))) {
+        std::cout << "No visible set for these models in " << PVS_FILE << ", PVS culling is off" << std::endl;
+    }
+    std::vector<unsigned char> frustumVisible;
+    double bvhUpdateMs = 0.0;
     //Loop until window closed
     while (!mainWindow.getShouldClose()) {
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -229,7 +402,36 @@ int main() {
 
         // section for checking mouse and keyboard input
         checkMouse();
+        glm::vec3 oldCameraPosition = cameraPosition;
         checkKeyboard(cameraPosition, cameraDirection, cameraRight, cameraUp);
+        if (SCENE_BVH && CAMERA_COLLISION && sceneBvh.GetObjectCount() == worldBounds.size()) {
+            resolveCameraCollision(oldCameraPosition, cameraPosition, worldBounds);
+        }
+
+        // pick the model under the crosshair on click
+        bool mouseDown = glfwGetMouseButton(mainWindow.getWindow(), GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        if (SCENE_BVH && mouseDown && !mouseWasDown) {
+            RayHit hit;
+            if (sceneBvh.Raycast(cameraPosition, cameraDirection, 500.0f, hit)) {
+                std::cout << "Picked " << models[hit.object].modelPath << " at " << hit.distance << std::endl;
+            } else {
+                std::cout << "Picked nothing" << std::endl;
+            }
+        }
+        mouseWasDown = mouseDown;
+
+        // switch between Hi-Z culling and drawing every model that passes the CPU tests
+        bool hiZKeyDown = glfwGetKey(mainWindow.getWindow(), GLFW_KEY_H) == GLFW_PRESS;
+        if (hiZKeyDown && !hiZKeyWasDown) {
+            if (hiZCuller.IsReady()) {
+                hiZEnabled = !hiZEnabled;
+                hiZCuller.Reset();
+                std::cout << "Hi-Z culling " << (hiZEnabled ? "on" : "off") << std::endl;
+            } else {
+                std::cout << "Hi-Z culling unavailable" << std::endl;
+            }
+        }
+        hiZKeyWasDown = hiZKeyDown;
 
         cameraRight = glm::normalize(glm::cross(cameraDirection, up));
         cameraUp = glm::normalize(glm::cross(cameraRight, cameraDirection));
@@ -239,12 +441,17 @@ int main() {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glm::mat4 view = glm::lookAt(cameraPosition, cameraPosition + cameraDirection, cameraUp);
+        glm::mat4 viewProjection = projection * view;
+        MeshletCullStats meshletStats;
+        unsigned int meshletModels = 0;
+        unsigned int trianglesSubmitted = 0;
+        unsigned int modelsPerLod[4] = {0, 0, 0, 0};
+        unsigned int objectsDrawn = 0, objectsCulled = 0, objectsOccluded = 0, objectsBehindPortals = 0, objectsOutsidePvs = 0;
+        // pixels covered by one world unit at distance 1
+        float pixelsPerUnit = projection[1][1] * mainWindow.getBufferHeight() * 0.5f;
 
         //draw here
         shaderList[0].UseShader();
-        uniformModel = shaderList[0].GetUniformLocation("model");
-        uniformProjection = shaderList[0].GetUniformLocation("projection");
-        uniformView = shaderList[0].GetUniformLocation("view");
 
         // load models incrementally to avoid freezing the window
         if (currentModel < models.size()) {
@@ -252,46 +459,253 @@ int main() {
             currentModel++;
         } else if (currentModel == models.size()) {
             std::cout << "( ˶ˆᗜˆ˵ ) All models are loaded ♡⸜(˶˃ ᵕ ˂˶)⸝♡" << std::endl;
+            const AssetRegistryStats &assetStats = AssetRegistry::Get().GetStats();
+            std::cout << "Assets: " << assetStats.loads << " loaded, " << assetStats.pathHits << " path hits, "
+                      << assetStats.contentHits << " content hits, " << assetStats.bytesSaved / 1048576.0
+                      << " MB not uploaded again, " << assetStats.bytesResident / 1048576.0 << " MB resident" << std::endl;
             currentModel++;
         }
 
-        //Object
+        // place every model, then cull them all at once before issuing any draws
+        modelMatrices.resize(meshList.size());
+        worldBounds.resize(meshList.size());
+        worldBoxes.Clear();
+        if (hiZEnabled) {
+            hiZCuller.SetObjectCount(meshList.size());
+        }
         for (int i = 0; i < meshList.size(); i++) {
-            glm::mat4 model(1.0f);
-            model = glm::translate(model, modelPositions[i]);
-            model = glm::scale(model, glm::vec3(modelScales[i]));
-
-            if (i == 2) {
-                // jump animation for TheCat
-                float jumpHeight = 8.0f;
-                float jumpSpeed = 10.0f;
-                float jump = sin(currentFrame * jumpSpeed) * jumpHeight;
-                model = glm::translate(model, glm::vec3(0.0f, jump, 0.0f));
-            } else if (i == 4) {
-                // rotate CatBanana
-                model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            } else if (i == 5) {
-                // rotate deal-with-it-doge
-                model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            } else if (i == 6) {
-                // rotate SaulGoodman
-                model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            } else if (i == 8) {
-                // rotate ace
-                model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-                model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            modelMatrices[i] = getModelMatrix(i, currentFrame);
+            worldBounds[i] = modelInstances[i] != nullptr ? modelInstances[i]->Place(modelMatrices[i], meshList[i]->GetBounds())
+                                                          : TransformBounds(meshList[i]->GetBounds(), modelMatrices[i]);
+            worldBoxes.Add(worldBounds[i].boxMin, worldBounds[i].boxMax);
+            if (hiZEnabled) {
+                // the GPU writes the commands, so a new LOD takes effect from the late pass on
+                // instanced models are drawn with their instances instead, so their commands stay empty
+                hiZCuller.SetObject(i, worldBounds[i], modelInstances[i] != nullptr ? DrawRange{0, 0, 0}
+                                                                                     : meshList[i]->GetDrawRange(modelLods[i]));
+            }
+        }
+        if (SCENE_BVH) {
+            // rebuild when a model finishes loading; otherwise refit on every frame, as TheCat's
+            // jump moves its box each frame and the refit is cheap next to a rebuild
+            auto bvhStart = std::chrono::steady_clock::now();
+            bool rebuild = sceneBvh.GetObjectCount() != worldBounds.size();
+            if (rebuild) {
+                sceneBvh.Build(worldBounds);
+            } else {
+                sceneBvh.Refit(worldBounds);
+            }
+            bvhUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bvhStart).count();
+            if (rebuild) {
+                std::cout << "Scene BVH built: " << sceneBvh.GetNodeCount() << " nodes in " << bvhUpdateMs << " ms" << std::endl;
+            }
+        }
+        modelVisible.assign(meshList.size(), 1);
+        if (PVS_CULLING && visibleSet.IsLoaded()) {
+            // a table lookup for the camera's cell, so it goes before every other test
+            objectsOutsidePvs = visibleSet.Cull(cameraPosition, modelVisible);
+        }
+        if (FRUSTUM_CULLING) {
+            if (SCENE_BVH) {
+                sceneBvh.QueryFrustum(Frustum(viewProjection), frustumVisible);
+            } else {
+                CullBoxes(Frustum(viewProjection), worldBoxes, frustumVisible);
+            }
+            for (int i = 0; i < meshList.size(); i++) {
+                modelVisible[i] = modelVisible[i] && frustumVisible[i];
+            }
+        }
+        if (PORTAL_CULLING && !cellPortals.IsEmpty()) {
+            // models in cells the camera cannot see into, or outside the view through the openings
+            portalStats = cellPortals.Cull(cameraPosition, viewProjection, worldBounds, modelVisible);
+            objectsBehindPortals = portalStats.objectsRejected;
+        }
+        if (OCCLUSION_CULLING) {
+            // rasterise the occluders in view, then test every other model in view against them
+            occlusionCuller.BeginFrame(viewProjection);
+            for (int i = 0; i < meshList.size(); i++) {
+                if (modelVisible[i] && meshList[i]->IsOccluder() && modelInstances[i] == nullptr) {
+                    occlusionCuller.AddOccluder(meshList[i]->GetOccluder(), modelMatrices[i]);
+                }
+            }
+            occlusionCuller.Rasterize();
+            for (int i = 0; i < meshList.size(); i++) {
+                if (modelVisible[i] && !meshList[i]->IsOccluder() &&
+                    !occlusionCuller.IsBoxVisible(worldBounds[i].boxMin, worldBounds[i].boxMax)) {
+                    modelVisible[i] = 0;
+                    objectsOccluded++;
+                }
             }
+        }
 
-            glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-            glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
-            glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(view));
+        // camera, light and every model's draw data in one buffer write, before any draw reads them
+        frameBlock.view = view;
+        frameBlock.projection = projection;
+        frameBlock.viewProjection = viewProjection;
+        frameBlock.lightColour = glm::vec4(lightColour, 1.0f);
+        frameBlock.time = currentFrame;
+        drawBlocks.resize(meshList.size());
+        for (int i = 0; i < meshList.size(); i++) {
+            drawBlocks[i].model = modelMatrices[i];
+            drawBlocks[i].positionScale = glm::vec4(meshList[i]->GetPositionScale(), 0.0f);
+            drawBlocks[i].positionOffset = glm::vec4(meshList[i]->GetPositionOffset(), 0.0f);
+            drawBlocks[i].octahedralNormals = meshList[i]->HasOctahedralNormals();
+        }
+        frameUniforms.Upload(frameBlock, drawBlocks);
+
+        auto setModelUniforms = [&](int i) {
+            frameUniforms.BindDraw(i);
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, modelTextures[i]);
-            meshList[i]->RenderMesh();
+        };
+
+        //Object
+        if (hiZEnabled) {
+            hiZCuller.BindEarlyCommands();
         }
+        for (int i = 0; i < meshList.size(); i++) {
+            if (!modelVisible[i]) {
+                objectsCulled++;
+                continue;
+            }
+            objectsDrawn++;
+            const glm::mat4 &model = modelMatrices[i];
+
+            // screen-space error of the bounding sphere picks the LOD
+            float distance = std::max(glm::length(worldBounds[i].sphereCenter - cameraPosition) - worldBounds[i].sphereRadius, 0.1f);
+            glm::vec3 extent = meshList[i]->GetBounds().GetBoxExtent();
+            float worldError = std::max(extent.x, std::max(extent.y, extent.z)) * modelScales[i];
+            unsigned int lod = selectLod(*meshList[i], worldError, distance, pixelsPerUnit, modelLods[i]);
+            modelLods[i] = lod;
+            modelsPerLod[std::min(lod, 3u)]++;
+
+            // conditionally rendered, instanced and meshlet-culled models keep their own draw,
+            // everything else goes in one batch
+            if (multiDrawEnabled && !hiZEnabled && !(OCCLUSION_QUERIES && modelOcclusionQueries[i]) &&
+                modelInstances[i] == nullptr && !(MESHLET_CULLING && lod == 0 && meshList[i]->HasMeshlets())) {
+                multiDraw.Add(*meshList[i], lod, model, modelTextures[i]);
+                trianglesSubmitted += meshList[i]->GetLod(lod).indexCount / 3;
+                continue;
+            }
 
-        // light
-        glUniform3fv(shaderList[0].GetUniformLocation("lightColour"), 1, (GLfloat *) &lightColour);
+            setModelUniforms(i);
+            // skipped on the GPU if last frame's box query found no visible samples
+            bool conditional = OCCLUSION_QUERIES && occlusionQueries.BeginConditionalRender(i);
+            if (modelInstances[i] != nullptr) {
+                // every instance in view in one draw, all at the LOD picked for the group
+                GLsizei instanceCount = modelInstances[i]->Cull(Frustum(viewProjection));
+                meshList[i]->RenderInstanced(lod, *modelInstances[i]);
+                trianglesSubmitted += meshList[i]->GetLod(lod).indexCount / 3 * instanceCount;
+            } else if (hiZEnabled) {
+                // early pass: whatever the Hi-Z test found visible last frame
+                meshList[i]->RenderIndirect(hiZCuller.GetCommandOffset(i));
+            } else if (MESHLET_CULLING && lod == 0) {
+                unsigned int drawnBefore = meshletStats.trianglesDrawn;
+                meshletModels++;
+                meshList[i]->RenderMeshlets(model, viewProjection, cameraPosition, MESHLET_CONE_CULLING, meshletStats);
+                trianglesSubmitted += meshletStats.trianglesDrawn - drawnBefore;
+            } else {
+                meshList[i]->RenderMesh(lod);
+                trianglesSubmitted += meshList[i]->GetLod(lod).indexCount / 3;
+            }
+            if (conditional) {
+                occlusionQueries.EndConditionalRender();
+            }
+        }
+        if (multiDrawEnabled && !hiZEnabled) {
+            multiDrawStats = multiDraw.Submit();
+            shaderList[0].UseShader();
+        }
+        if (hiZEnabled) {
+            // late pass: test everything against the early pass's depth, then draw what it missed
+            hiZCuller.UnbindCommands();
+            hiZCuller.BuildPyramid();
+            hiZCuller.Cull(viewProjection);
+            shaderList[0].UseShader();
+            hiZCuller.BindLateCommands();
+            for (int i = 0; i < meshList.size(); i++) {
+                if (modelVisible[i] && modelInstances[i] == nullptr) {
+                    setModelUniforms(i);
+                    meshList[i]->RenderIndirect(hiZCuller.GetCommandOffset(i));
+                }
+            }
+            hiZCuller.UnbindCommands();
+        }
+
+        if (FRAME_STATS_INTERVAL > 0.0f && currentFrame - lastStatsTime >= FRAME_STATS_INTERVAL) {
+            lastStatsTime = currentFrame;
+            std::cout << "Objects: " << objectsDrawn << " drawn, " << objectsOutsidePvs << " outside PVS, "
+                      << objectsCulled - objectsOutsidePvs - objectsOccluded - objectsBehindPortals
+                      << " frustum culled, " << objectsBehindPortals << " behind portals, " << objectsOccluded << " occluded" << std::endl;
+            if (portalStats.active) {
+                std::cout << "Portals: " << portalStats.cellsVisited << " cells visited, " << portalStats.portalsTraversed
+                          << " portals traversed, " << portalStats.objectsRejected << " objects rejected" << std::endl;
+            }
+            if (OCCLUSION_CULLING) {
+                const OcclusionStats &occlusionStats = occlusionCuller.GetStats();
+                std::cout << "Occlusion: " << occlusionStats.occluderTriangles << " occluder triangles rasterised in "
+                          << occlusionStats.rasterizeMs << " ms" << std::endl;
+            }
+            if (hiZEnabled) {
+                HiZStats hiZStats = hiZCuller.ReadStats();
+                std::cout << "Hi-Z: " << hiZStats.tested << " tested, " << hiZStats.frustumCulled << " frustum culled, "
+                          << hiZStats.occluded << " occluded, " << hiZStats.newlyVisible << " drawn late" << std::endl;
+            }
+            if (OCCLUSION_QUERIES) {
+                for (int i = 0; i < meshList.size(); i++) {
+                    if (modelOcclusionQueries[i]) {
+                        const OcclusionQueryStats &queryStats = occlusionQueries.GetStats(i);
+                        std::cout << "Occlusion query " << models[i].modelPath << ": " << queryStats.occluded << " / "
+                                  << queryStats.results << " hidden (" << queryStats.GetHitRate() * 100.0f << "% hit rate)" << std::endl;
+                    }
+                }
+            }
+            if (SCENE_BVH) {
+                std::cout << "Scene BVH refit: " << bvhUpdateMs << " ms" << std::endl;
+            }
+            for (GeometryHeap *heap : GeometryHeap::GetHeaps()) {
+                // one heap per vertex format, so compact and full-precision meshes are listed apart
+                GeometryHeapStats heapStats = heap->GetStats();
+                std::cout << "Geometry heap (" << heap->GetStride() << "-byte vertices): vertices "
+                          << heapStats.vertexBytesUsed / 1048576.0 << " / " << heapStats.vertexBytesCapacity / 1048576.0
+                          << " MB, indices " << heapStats.indexBytesUsed / 1048576.0
+                          << " / " << heapStats.indexBytesCapacity / 1048576.0 << " MB, " << heapStats.allocations
+                          << " meshes, " << heapStats.freeBlocks << " free blocks, " << heapStats.grows << " grows" << std::endl;
+            }
+            if (hiZEnabled) {
+                // the GPU decides what is drawn, so only the LOD choice is known here
+                std::cout << "Models per LOD: " << modelsPerLod[0] << " / " << modelsPerLod[1] << " / "
+                          << modelsPerLod[2] << " / " << modelsPerLod[3] << std::endl;
+            } else {
+                std::cout << "Triangles submitted: " << trianglesSubmitted << ", models per LOD: " << modelsPerLod[0]
+                          << " / " << modelsPerLod[1] << " / " << modelsPerLod[2] << " / " << modelsPerLod[3] << std::endl;
+            }
+            const ShaderUniformStats &uniformStats = Shader::GetUniformStats();
+            std::cout << "Uniforms: " << uniformStats.uploads << " uploaded, " << uniformStats.skipped
+                      << " skipped as unchanged" << std::endl;
+            Shader::ResetUniformStats();
+            if (multiDrawEnabled && !hiZEnabled) {
+                std::cout << "Multi-draw: " << multiDrawStats.draws << " models in " << multiDrawStats.calls
+                          << " glMultiDrawElementsIndirect calls" << std::endl;
+            }
+            if (MESHLET_CULLING && !hiZEnabled) {
+                // only the models drawn at LOD 0 go through meshlets, which may be none of them
+                std::cout << "Meshlets: " << meshletModels << " models, " << meshletStats.tested << " tested, " << meshletStats.frustumCulled
+                          << " frustum culled, " << meshletStats.backfaceCulled << " back-face culled, "
+                          << meshletStats.trianglesDrawn << " triangles drawn" << std::endl;
+            }
+        }
+
+        if (OCCLUSION_QUERIES) {
+            // query the boxes of opted-in models in view against this frame's finished depth
+            modelQueried.resize(meshList.size());
+            for (int i = 0; i < meshList.size(); i++) {
+                modelQueried[i] = modelOcclusionQueries[i] && modelVisible[i];
+            }
+            occlusionQueries.IssueQueries(worldBounds, modelQueried, viewProjection, cameraPosition);
+            // the box draws bound their own VAO
+            GeometryHeap::InvalidateBinding();
+        }
 
         glUseProgram(0);
         //end draw
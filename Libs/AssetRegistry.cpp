@@ -0,0 +1,186 @@
+#include "AssetRegistry.h"
+
+#include <filesystem>
+#include <iostream>
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "stb_image.h"
+
+static const size_t NOT_FOUND = SIZE_MAX;
+
+AssetRegistry &AssetRegistry::Get() {
+    static AssetRegistry registry;
+    return registry;
+}
+
+Mesh *AssetRegistry::AcquireMesh(const char *path, bool keepOccluder) {
+    char option = keepOccluder ? 'o' : '-';
+    std::string pathKey = GetPathKey(MESH, path, option);
+    std::string contentKey;
+    size_t slot = Find(MESH, path, option, pathKey, contentKey);
+    if (slot != NOT_FOUND) {
+        std::cout << "Sharing mesh " << path << std::endl;
+        return assets[slot].mesh;
+    }
+
+    Mesh *mesh = new Mesh();
+    if (!mesh->CreateMeshFromOBJ(path, keepOccluder)) {
+        delete mesh;
+        return nullptr;
+    }
+    Asset asset{MESH, mesh, 0, mesh->GetGpuBytes(), 1, {}, contentKey};
+    byMesh[mesh] = Add(std::move(asset), pathKey);
+    return mesh;
+}
+
+void AssetRegistry::ReleaseMesh(Mesh *mesh) {
+    auto found = byMesh.find(mesh);
+    if (found != byMesh.end()) {
+        Release(found->second);
+    }
+}
+
+GLuint AssetRegistry::AcquireTexture(const char *path, bool isFlipped) {
+    char option = isFlipped ? 'f' : '-';
+    std::string pathKey = GetPathKey(TEXTURE, path, option);
+    std::string contentKey;
+    size_t slot = Find(TEXTURE, path, option, pathKey, contentKey);
+    if (slot != NOT_FOUND) {
+        std::cout << "Sharing texture " << path << std::endl;
+        return assets[slot].texture;
+    }
+
+    size_t gpuBytes = 0;
+    GLuint texture = UploadTexture(path, isFlipped, gpuBytes);
+    // a failed decode is not shared, so a later request tries the file again
+    Asset asset{TEXTURE, nullptr, texture, gpuBytes, 1, {}, gpuBytes > 0 ? contentKey : std::string()};
+    byTexture[texture] = Add(std::move(asset), gpuBytes > 0 ? pathKey : std::string());
+    return texture;
+}
+
+void AssetRegistry::ReleaseTexture(GLuint texture) {
+    auto found = byTexture.find(texture);
+    if (found != byTexture.end()) {
+        Release(found->second);
+    }
+}
+
+size_t AssetRegistry::Find(AssetType type, const char *path, char option, const std::string &pathKey,
+                           std::string &contentKey) {
+    auto found = byPath.find(pathKey);
+    if (found != byPath.end()) {
+        stats.pathHits++;
+    } else if (!(contentKey = GetContentKey(type, path, option)).empty() &&
+               (found = byContent.find(contentKey)) != byContent.end()) {
+        stats.contentHits++;
+        // remember the new path, so its next request skips hashing the file
+        byPath[pathKey] = found->second;
+        assets[found->second].pathKeys.push_back(pathKey);
+    } else {
+        return NOT_FOUND;
+    }
+    Asset &asset = assets[found->second];
+    asset.references++;
+    stats.bytesSaved += asset.gpuBytes;
+    return found->second;
+}
+
+size_t AssetRegistry::Add(Asset asset, const std::string &pathKey) {
+    size_t slot;
+    if (freeSlots.empty()) {
+        slot = assets.size();
+        assets.emplace_back();
+    } else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    if (!pathKey.empty()) {
+        asset.pathKeys.push_back(pathKey);
+        byPath[pathKey] = slot;
+    }
+    if (!asset.contentKey.empty()) {
+        byContent[asset.contentKey] = slot;
+    }
+    stats.loads++;
+    stats.bytesResident += asset.gpuBytes;
+    assets[slot] = std::move(asset);
+    return slot;
+}
+
+void AssetRegistry::Release(size_t slot) {
+    Asset &asset = assets[slot];
+    if (asset.references == 0 || --asset.references > 0) {
+        return;
+    }
+    for (const std::string &pathKey : asset.pathKeys) {
+        byPath.erase(pathKey);
+    }
+    if (!asset.contentKey.empty()) {
+        byContent.erase(asset.contentKey);
+    }
+    if (asset.type == MESH) {
+        byMesh.erase(asset.mesh);
+        delete asset.mesh;
+    } else {
+        byTexture.erase(asset.texture);
+        glDeleteTextures(1, &asset.texture);
+    }
+    stats.bytesResident -= asset.gpuBytes;
+    asset = Asset{};
+    freeSlots.push_back(slot);
+}
+
+std::string AssetRegistry::GetPathKey(AssetType type, const char *path, char option) {
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    std::string key = error ? std::string(path) : canonical.string();
+    return std::string(1, type == MESH ? 'm' : 't') + option + key;
+}
+
+std::string AssetRegistry::GetContentKey(AssetType type, const char *path, char option) {
+    // the mesh cache already hashes sources quickly enough to validate blobs with
+    MeshSourceKey source;
+    if (!MeshCache::ComputeSourceKey(path, source)) {
+        return std::string();
+    }
+    return std::string(1, type == MESH ? 'm' : 't') + option + std::to_string(source.size) + ":" + std::to_string(source.hash);
+}
+
+GLuint AssetRegistry::UploadTexture(const char *path, bool isFlipped, size_t &gpuBytes) {
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    std::cout << "Loading texture " << path << std::endl;
+
+    int width, height, nrChannels;
+    stbi_set_flip_vertically_on_load(isFlipped);
+    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
+    gpuBytes = 0;
+    if (data) {
+        GLint format;
+        // set format based on number of channels
+        if (nrChannels == 1)
+            format = GL_RED;
+        else if (nrChannels == 3)
+            format = GL_RGB;
+        else if (nrChannels == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // the mip chain adds about a third
+        gpuBytes = size_t(width) * height * nrChannels * 4 / 3;
+        std::cout << "Texture loaded" << std::endl;
+    } else {
+        std::cout << "Failed to load " << path << std::endl;
+    }
+    stbi_image_free(data);
+    return textureID;
+}
@@ -0,0 +1,101 @@
+#ifndef ASSETREGISTRY_H
+#define ASSETREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+
+class Mesh;
+
+struct AssetRegistryStats {
+    // assets read, decoded and uploaded
+    unsigned int loads = 0;
+    // requests for a path that was already loaded
+    unsigned int pathHits = 0;
+    // requests for another path with the same bytes as a loaded asset
+    unsigned int contentHits = 0;
+    // GPU memory the hits did not upload a second time
+    size_t bytesSaved = 0;
+    // GPU memory held by live assets
+    size_t bytesResident = 0;
+};
+
+/**
+ * Shared, reference-counted meshes and textures. A request is first looked up by
+ * canonical path, then by the source file's size and content hash, so the same OBJ or
+ * image reached through two paths is still parsed, decoded and uploaded once. Every
+ * Acquire takes a reference that a matching Release gives back; the GPU objects are freed
+ * with the last one.
+ */
+class AssetRegistry {
+public:
+    /**
+     * The registry of the process, created on first use.
+     */
+    static AssetRegistry &Get();
+
+    AssetRegistry(const AssetRegistry &) = delete;
+    AssetRegistry &operator=(const AssetRegistry &) = delete;
+
+    /**
+     * Load an OBJ through Mesh::CreateMeshFromOBJ, or share the mesh already loaded from it.
+     * @param keepOccluder Passed on to CreateMeshFromOBJ; meshes with and without one are
+     *                     not shared.
+     * @return nullptr if the file could not be loaded.
+     */
+    Mesh *AcquireMesh(const char *path, bool keepOccluder = false);
+    void ReleaseMesh(Mesh *mesh);
+
+    /**
+     * Load an image as a mipmapped GL_TEXTURE_2D, or share the texture already made from it.
+     * Like before, a file that cannot be decoded still gets a texture name, with no image.
+     * @param isFlipped Whether rows are flipped on load; flipped and unflipped are not shared.
+     */
+    GLuint AcquireTexture(const char *path, bool isFlipped = true);
+    void ReleaseTexture(GLuint texture);
+
+    const AssetRegistryStats &GetStats() const { return stats; }
+
+private:
+    enum AssetType { MESH, TEXTURE };
+
+    struct Asset {
+        AssetType type;
+        Mesh *mesh;
+        GLuint texture;
+        size_t gpuBytes;
+        unsigned int references;
+        // lookup keys pointing at this asset, removed with it
+        std::vector<std::string> pathKeys;
+        std::string contentKey;
+    };
+
+    std::vector<Asset> assets;
+    std::vector<size_t> freeSlots;
+    std::unordered_map<std::string, size_t> byPath;
+    std::unordered_map<std::string, size_t> byContent;
+    std::unordered_map<const Mesh *, size_t> byMesh;
+    std::unordered_map<GLuint, size_t> byTexture;
+    AssetRegistryStats stats;
+
+    AssetRegistry() = default;
+
+    // the asset already loaded for pathKey, or else for the file's contents, with a new
+    // reference; SIZE_MAX if none. The file is only hashed on a path miss, into contentKey.
+    size_t Find(AssetType type, const char *path, char option, const std::string &pathKey, std::string &contentKey);
+    size_t Add(Asset asset, const std::string &pathKey);
+    void Release(size_t slot);
+
+    // canonical path, plus the load options that change what ends up on the GPU
+    static std::string GetPathKey(AssetType type, const char *path, char option);
+    // source size and hash, plus the same options; empty if the file cannot be read
+    static std::string GetContentKey(AssetType type, const char *path, char option);
+    // decode and upload an image, as loadTexture used to
+    static GLuint UploadTexture(const char *path, bool isFlipped, size_t &gpuBytes);
+};
+
+#endif //ASSETREGISTRY_H
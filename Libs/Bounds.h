@@ -0,0 +1,106 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+/**
+ * Bounding volumes of a mesh: an axis-aligned box for tight tests and a sphere for
+ * cheap, rotation-independent ones.
+ */
+struct Bounds {
+    glm::vec3 boxMin = glm::vec3(0.0f);
+    glm::vec3 boxMax = glm::vec3(0.0f);
+    glm::vec3 sphereCenter = glm::vec3(0.0f);
+    float sphereRadius = 0.0f;
+
+    glm::vec3 GetBoxCenter() const { return (boxMin + boxMax) * 0.5f; }
+    glm::vec3 GetBoxExtent() const { return boxMax - boxMin; }
+};
+
+/**
+ * Bound a set of points: the exact AABB and Ritter's bounding sphere, or the sphere
+ * around the AABB if that happens to be smaller.
+ * @param positions Pointer to the first position.
+ * @param count Number of points.
+ * @param stride Bytes between consecutive positions.
+ */
+inline Bounds ComputeBounds(const glm::vec3 *positions, size_t count, size_t stride) {
+    Bounds bounds;
+    if (count == 0) {
+        return bounds;
+    }
+    auto at = [positions, stride](size_t i) -> const glm::vec3 & {
+        return *reinterpret_cast<const glm::vec3 *>(reinterpret_cast<const char *>(positions) + i * stride);
+    };
+
+    bounds.boxMin = bounds.boxMax = at(0);
+    for (size_t i = 1; i < count; i++) {
+        bounds.boxMin = glm::min(bounds.boxMin, at(i));
+        bounds.boxMax = glm::max(bounds.boxMax, at(i));
+    }
+
+    // Ritter: start from two far-apart points, then grow to cover any point left outside
+    auto farthestFrom = [&](const glm::vec3 &from) {
+        size_t best = 0;
+        float bestDistance = -1.0f;
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 d = at(i) - from;
+            float distance = glm::dot(d, d);
+            if (distance > bestDistance) {
+                bestDistance = distance;
+                best = i;
+            }
+        }
+        return at(best);
+    };
+    glm::vec3 a = farthestFrom(at(0));
+    glm::vec3 b = farthestFrom(a);
+    glm::vec3 center = (a + b) * 0.5f;
+    float radius = glm::length(b - a) * 0.5f;
+    for (size_t i = 0; i < count; i++) {
+        float distance = glm::length(at(i) - center);
+        if (distance > radius) {
+            float grown = (radius + distance) * 0.5f;
+            center += (at(i) - center) * ((grown - radius) / distance);
+            radius = grown;
+        }
+    }
+
+    float boxRadius = glm::length(bounds.GetBoxExtent()) * 0.5f;
+    if (boxRadius <= radius) {
+        center = bounds.GetBoxCenter();
+        radius = boxRadius;
+    }
+    bounds.sphereCenter = center;
+    bounds.sphereRadius = radius;
+    return bounds;
+}
+
+/**
+ * Bounds of a mesh after it is placed by a model matrix. The box is the AABB of the
+ * transformed box (Arvo), the sphere is scaled by the largest axis scale.
+ */
+inline Bounds TransformBounds(const Bounds &bounds, const glm::mat4 &model) {
+    Bounds result;
+    glm::vec3 center = glm::vec3(model * glm::vec4(bounds.GetBoxCenter(), 1.0f));
+    glm::vec3 halfExtent = bounds.GetBoxExtent() * 0.5f;
+    glm::vec3 transformedHalf;
+    for (int row = 0; row < 3; row++) {
+        transformedHalf[row] = std::fabs(model[0][row]) * halfExtent.x +
+                               std::fabs(model[1][row]) * halfExtent.y +
+                               std::fabs(model[2][row]) * halfExtent.z;
+    }
+    result.boxMin = center - transformedHalf;
+    result.boxMax = center + transformedHalf;
+
+    float scale = std::max(glm::length(glm::vec3(model[0])),
+                           std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    result.sphereCenter = glm::vec3(model * glm::vec4(bounds.sphereCenter, 1.0f));
+    result.sphereRadius = bounds.sphereRadius * scale;
+    return result;
+}
+
+#endif //BOUNDS_H
@@ -0,0 +1,246 @@
+#include "CellPortals.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+#include "Frustum.h"
+
+// bounds the number of paths explored when cells are joined by many portals
+static const size_t MAX_CELL_VIEWS = 256;
+// a camera this close to a portal's plane looks through it without narrowing the view
+static const float PORTAL_PLANE_EPSILON = 1e-3f;
+
+bool CellPortalGraph::Load(const char *path) {
+    cells.clear();
+    portals.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::unordered_map<std::string, unsigned int> cellIndices;
+    std::string line;
+    int lineNumber = 0;
+    bool valid = true;
+    while (valid && getline(file, line)) {
+        lineNumber++;
+        std::istringstream lineStream(line.substr(0, line.find('#')));
+        std::string prefix;
+        if (!(lineStream >> prefix)) {
+            continue;
+        }
+
+        if (prefix == "cell") {
+            Cell cell;
+            lineStream >> cell.name >> cell.boxMin.x >> cell.boxMin.y >> cell.boxMin.z
+                       >> cell.boxMax.x >> cell.boxMax.y >> cell.boxMax.z;
+            valid = !lineStream.fail() && cellIndices.count(cell.name) == 0;
+            cellIndices[cell.name] = static_cast<unsigned int>(cells.size());
+            cells.push_back(cell);
+        } else if (prefix == "portal") {
+            std::string names[2];
+            lineStream >> names[0] >> names[1];
+            valid = !lineStream.fail() && cellIndices.count(names[0]) != 0 && cellIndices.count(names[1]) != 0 &&
+                    names[0] != names[1];
+            Portal portal;
+            glm::vec3 point;
+            while (valid && lineStream >> point.x >> point.y >> point.z) {
+                portal.polygon.push_back(point);
+            }
+            valid = valid && portal.polygon.size() >= 3 && lineStream.eof();
+            if (valid) {
+                unsigned int index = static_cast<unsigned int>(portals.size());
+                for (int side = 0; side < 2; side++) {
+                    portal.cells[side] = cellIndices[names[side]];
+                    cells[portal.cells[side]].portals.push_back(index);
+                }
+                portals.push_back(portal);
+            }
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        std::cerr << "Error: " << path << ":" << lineNumber << ": malformed cell or portal" << std::endl;
+        cells.clear();
+        portals.clear();
+        return false;
+    }
+    std::cout << "Loaded " << cells.size() << " cells and " << portals.size() << " portals from " << path << std::endl;
+    return true;
+}
+
+static bool ContainsPoint(const Cell &cell, const glm::vec3 &point) {
+    return point.x >= cell.boxMin.x && point.y >= cell.boxMin.y && point.z >= cell.boxMin.z &&
+           point.x <= cell.boxMax.x && point.y <= cell.boxMax.y && point.z <= cell.boxMax.z;
+}
+
+static bool OverlapsBox(const Cell &cell, const Bounds &bounds) {
+    return bounds.boxMax.x >= cell.boxMin.x && bounds.boxMax.y >= cell.boxMin.y && bounds.boxMax.z >= cell.boxMin.z &&
+           bounds.boxMin.x <= cell.boxMax.x && bounds.boxMin.y <= cell.boxMax.y && bounds.boxMin.z <= cell.boxMax.z;
+}
+
+static bool ContainsBox(const glm::vec3 &outerMin, const glm::vec3 &outerMax, const glm::vec3 &innerMin, const glm::vec3 &innerMax) {
+    return innerMin.x >= outerMin.x && innerMin.y >= outerMin.y && innerMin.z >= outerMin.z &&
+           innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+}
+
+// true if the box lies entirely behind one of the planes
+static bool IsBoxOutside(const std::vector<glm::vec4> &planes, const Bounds &bounds) {
+    for (const glm::vec4 &plane : planes) {
+        glm::vec3 farthest(plane.x >= 0.0f ? bounds.boxMax.x : bounds.boxMin.x,
+                           plane.y >= 0.0f ? bounds.boxMax.y : bounds.boxMin.y,
+                           plane.z >= 0.0f ? bounds.boxMax.z : bounds.boxMin.z);
+        if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// keep the part of a convex polygon in front of the plane
+static std::vector<glm::vec3> ClipPolygon(const std::vector<glm::vec3> &polygon, const glm::vec4 &plane) {
+    std::vector<glm::vec3> clipped;
+    for (size_t i = 0; i < polygon.size(); i++) {
+        const glm::vec3 &a = polygon[i], &b = polygon[(i + 1) % polygon.size()];
+        float da = glm::dot(glm::vec3(plane), a) + plane.w, db = glm::dot(glm::vec3(plane), b) + plane.w;
+        if (da >= 0.0f) {
+            clipped.push_back(a);
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            clipped.push_back(a + (b - a) * (da / (da - db)));
+        }
+    }
+    return clipped;
+}
+
+int CellPortalGraph::FindCell(const glm::vec3 &point) const {
+    int best = -1;
+    float bestVolume = 0.0f;
+    for (size_t i = 0; i < cells.size(); i++) {
+        if (!ContainsPoint(cells[i], point)) {
+            continue;
+        }
+        glm::vec3 size = cells[i].boxMax - cells[i].boxMin;
+        float volume = size.x * size.y * size.z;
+        if (best < 0 || volume < bestVolume) {
+            best = static_cast<int>(i);
+            bestVolume = volume;
+        }
+    }
+    return best;
+}
+
+PortalStats CellPortalGraph::Cull(const glm::vec3 &cameraPosition, const glm::mat4 &viewProjection,
+                                  const std::vector<Bounds> &worldBounds, std::vector<unsigned char> &visible) const {
+    PortalStats stats;
+    int start = FindCell(cameraPosition);
+    if (start < 0) {
+        return stats;
+    }
+    stats.active = true;
+
+    Frustum frustum(viewProjection);
+    CellView root;
+    root.cell = static_cast<unsigned int>(start);
+    root.planes.assign(frustum.planes, frustum.planes + 6);
+    std::vector<CellView> views;
+    std::vector<unsigned char> onPath(cells.size(), 0);
+    Traverse(root, cameraPosition, onPath, views, stats);
+
+    std::vector<unsigned char> objectCells;
+
+    for (size_t i = 0; i < worldBounds.size() && i < visible.size(); i++) {
+        if (!visible[i]) {
+            continue;
+        }
+        // a cell nested in another, like a room in an outdoor cell, is carved out of it:
+        // an object wholly inside the inner cell is not in the outer one
+        objectCells.assign(cells.size(), 0);
+        bool inAnyCell = false;
+        for (size_t c = 0; c < cells.size(); c++) {
+            objectCells[c] = OverlapsBox(cells[c], worldBounds[i]);
+            for (size_t inner = 0; inner < cells.size() && objectCells[c]; inner++) {
+                objectCells[c] = inner == c ||
+                                 !ContainsBox(cells[c].boxMin, cells[c].boxMax, cells[inner].boxMin, cells[inner].boxMax) ||
+                                 !ContainsBox(cells[inner].boxMin, cells[inner].boxMax, worldBounds[i].boxMin, worldBounds[i].boxMax);
+            }
+            inAnyCell = inAnyCell || objectCells[c];
+        }
+        if (!inAnyCell) {
+            continue;
+        }
+        bool seen = false;
+        for (size_t v = 0; v < views.size() && !seen; v++) {
+            seen = objectCells[views[v].cell] && !IsBoxOutside(views[v].planes, worldBounds[i]);
+        }
+        if (!seen) {
+            visible[i] = 0;
+            stats.objectsRejected++;
+        }
+    }
+    return stats;
+}
+
+void CellPortalGraph::Traverse(const CellView &view, const glm::vec3 &cameraPosition, std::vector<unsigned char> &onPath,
+                               std::vector<CellView> &views, PortalStats &stats) const {
+    stats.cellsVisited++;
+    views.push_back(view);
+    onPath[view.cell] = 1;
+
+    for (unsigned int portalIndex : cells[view.cell].portals) {
+        const Portal &portal = portals[portalIndex];
+        unsigned int next = portal.cells[0] == view.cell ? portal.cells[1] : portal.cells[0];
+        if (onPath[next] || views.size() >= MAX_CELL_VIEWS) {
+            continue;
+        }
+
+        // the part of the portal inside the current view
+        std::vector<glm::vec3> opening = portal.polygon;
+        for (size_t p = 0; p < view.planes.size() && opening.size() >= 3; p++) {
+            opening = ClipPolygon(opening, view.planes[p]);
+        }
+        if (opening.size() < 3) {
+            continue;
+        }
+
+        CellView child;
+        child.cell = next;
+        child.planes = view.planes;
+        glm::vec3 normal = glm::cross(portal.polygon[1] - portal.polygon[0], portal.polygon[2] - portal.polygon[0]);
+        float normalLength = glm::length(normal);
+        float cameraDistance = normalLength > 0.0f ? (glm::dot(normal, cameraPosition - portal.polygon[0])) / normalLength : 0.0f;
+        if (std::abs(cameraDistance) > PORTAL_PLANE_EPSILON) {
+            // beyond the portal, on the side away from the camera
+            normal /= cameraDistance > 0.0f ? -normalLength : normalLength;
+            child.planes.push_back(glm::vec4(normal, -glm::dot(normal, portal.polygon[0])));
+
+            // one plane through the camera and each edge of the opening, facing its middle
+            glm::vec3 center(0.0f);
+            for (const glm::vec3 &point : opening) {
+                center += point;
+            }
+            center /= static_cast<float>(opening.size());
+            for (size_t e = 0; e < opening.size(); e++) {
+                glm::vec3 edgeNormal = glm::cross(opening[e] - cameraPosition, opening[(e + 1) % opening.size()] - cameraPosition);
+                float length = glm::length(edgeNormal);
+                if (length < 1e-6f) {
+                    continue;
+                }
+                edgeNormal /= length;
+                if (glm::dot(edgeNormal, center - cameraPosition) < 0.0f) {
+                    edgeNormal = -edgeNormal;
+                }
+                child.planes.push_back(glm::vec4(edgeNormal, -glm::dot(edgeNormal, cameraPosition)));
+            }
+        }
+        stats.portalsTraversed++;
+        Traverse(child, cameraPosition, onPath, views, stats);
+    }
+
+    onPath[view.cell] = 0;
+}
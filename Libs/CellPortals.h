@@ -0,0 +1,85 @@
+#ifndef CELLPORTALS_H
+#define CELLPORTALS_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+/**
+ * Axis-aligned region of the scene, such as a room, joined to others by portals.
+ */
+struct Cell {
+    std::string name;
+    glm::vec3 boxMin, boxMax;
+    std::vector<unsigned int> portals;
+};
+
+/**
+ * Convex opening between two cells, such as a door or window, wound in either direction.
+ */
+struct Portal {
+    unsigned int cells[2];
+    std::vector<glm::vec3> polygon;
+};
+
+struct PortalStats {
+    // false when there are no cells or the camera is outside all of them
+    bool active = false;
+    unsigned int cellsVisited = 0;
+    unsigned int portalsTraversed = 0;
+    unsigned int objectsRejected = 0;
+};
+
+/**
+ * Cell-and-portal visibility. Starting from the camera's cell, each portal that is visible
+ * through the current view volume narrows it to the planes through the camera and the
+ * portal's clipped edges, and traversal continues into the cell behind. An object is kept
+ * if its box overlaps some reached cell inside that cell's view volume, so objects in
+ * cells that cannot be seen, or behind walls around the openings, are rejected.
+ */
+class CellPortalGraph {
+public:
+    /**
+     * Read cells and portals from a text file:
+     *   cell <name> <minX> <minY> <minZ> <maxX> <maxY> <maxZ>
+     *   portal <cell> <cell> <x> <y> <z> <x> <y> <z> <x> <y> <z> [...]
+     * with one convex polygon of at least three points per portal. '#' starts a comment.
+     * @return false if the file is missing or malformed; the graph is then left empty.
+     */
+    bool Load(const char *path);
+
+    bool IsEmpty() const { return cells.empty(); }
+    size_t GetCellCount() const { return cells.size(); }
+    size_t GetPortalCount() const { return portals.size(); }
+
+    /**
+     * Smallest cell containing the point, so a room inside an outdoor cell wins; -1 for none.
+     */
+    int FindCell(const glm::vec3 &point) const;
+
+    /**
+     * Clear visible[i] for objects no portal path can see. Objects overlapping no cell are
+     * left alone, and nothing is rejected while the camera is outside every cell.
+     */
+    PortalStats Cull(const glm::vec3 &cameraPosition, const glm::mat4 &viewProjection,
+                     const std::vector<Bounds> &worldBounds, std::vector<unsigned char> &visible) const;
+
+private:
+    // one way of seeing into a cell: the planes (as in Frustum) bounding the view through
+    // the portals on the path there
+    struct CellView {
+        unsigned int cell;
+        std::vector<glm::vec4> planes;
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Portal> portals;
+
+    void Traverse(const CellView &view, const glm::vec3 &cameraPosition, std::vector<unsigned char> &onPath,
+                  std::vector<CellView> &views, PortalStats &stats) const;
+};
+
+#endif //CELLPORTALS_H
@@ -0,0 +1,69 @@
+#include "FrameUniforms.h"
+
+#include <cstring>
+
+static size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameUniforms::FrameUniforms() {
+    for (unsigned int i = 0; i < RING_SIZE; i++) {
+        buffers[i] = 0;
+        capacities[i] = 0;
+    }
+    current = 0;
+    drawsOffset = 0;
+    drawStride = 0;
+}
+
+FrameUniforms::~FrameUniforms() {
+    for (GLuint &buffer : buffers) {
+        if (buffer != 0) {
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+        }
+    }
+}
+
+void FrameUniforms::Initialise() {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = alignment > 0 ? alignment : 256;
+    drawsOffset = AlignUp(sizeof(FrameBlock), alignment);
+    drawStride = AlignUp(sizeof(DrawBlock), alignment);
+    if (buffers[0] == 0) {
+        glGenBuffers(RING_SIZE, buffers);
+    }
+}
+
+void FrameUniforms::BindBlocks(Shader &shader) {
+    shader.BindUniformBlock("Frame", FRAME_BINDING);
+    shader.BindUniformBlock("Draw", DRAW_BINDING);
+}
+
+void FrameUniforms::Upload(const FrameBlock &frame, const std::vector<DrawBlock> &draws) {
+    if (buffers[0] == 0) {
+        return;
+    }
+    current = (current + 1) % RING_SIZE;
+    size_t size = drawsOffset + draws.size() * drawStride;
+    staging.resize(size);
+    memcpy(staging.data(), &frame, sizeof(FrameBlock));
+    for (size_t i = 0; i < draws.size(); i++) {
+        memcpy(staging.data() + drawsOffset + i * drawStride, &draws[i], sizeof(DrawBlock));
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffers[current]);
+    if (capacities[current] < size) {
+        glBufferData(GL_UNIFORM_BUFFER, size, staging.data(), GL_DYNAMIC_DRAW);
+        capacities[current] = size;
+    } else {
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, size, staging.data());
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BINDING, buffers[current], 0, sizeof(FrameBlock));
+}
+
+void FrameUniforms::BindDraw(size_t i) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BINDING, buffers[current], drawsOffset + i * drawStride, sizeof(DrawBlock));
+}
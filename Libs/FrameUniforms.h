@@ -0,0 +1,83 @@
+#ifndef FRAMEUNIFORMS_H
+#define FRAMEUNIFORMS_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+// std140 layout of the Frame block in shader.vert, shader.frag and the multi-draw shaders
+struct FrameBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    // rgb; a is unused
+    glm::vec4 lightColour;
+    // seconds since start
+    float time;
+    float padding[3];
+};
+
+// std140 layout of the Draw block in shader.vert
+struct DrawBlock {
+    glm::mat4 model;
+    // dequantisation of compact positions, xyz
+    glm::vec4 positionScale;
+    glm::vec4 positionOffset;
+    GLint octahedralNormals;
+    GLint padding[3];
+};
+
+/**
+ * Uniform buffers for what shader.vert and shader.frag read per frame and per draw. Upload
+ * writes the Frame block and every object's Draw block into one buffer, once per frame,
+ * and BindDraw then only moves the Draw binding to an object's slice. The buffers form a
+ * ring of RING_SIZE, so a frame's writes go to a buffer the GPU finished reading a couple
+ * of frames ago instead of waiting on the one it is drawing from.
+ */
+class FrameUniforms {
+public:
+    static const GLuint FRAME_BINDING = 0;
+    static const GLuint DRAW_BINDING = 1;
+    static const unsigned int RING_SIZE = 3;
+
+    FrameUniforms();
+    ~FrameUniforms();
+
+    FrameUniforms(const FrameUniforms &) = delete;
+    FrameUniforms &operator=(const FrameUniforms &) = delete;
+
+    /**
+     * Create the buffers; needs a GL context.
+     */
+    void Initialise();
+
+    /**
+     * Point a program's Frame and Draw blocks, whichever it has, at the bindings above.
+     */
+    static void BindBlocks(Shader &shader);
+
+    /**
+     * Write this frame's blocks into the next buffer of the ring and bind its Frame block.
+     * @param draws Draw block of each object, in the order BindDraw indexes them.
+     */
+    void Upload(const FrameBlock &frame, const std::vector<DrawBlock> &draws);
+
+    /**
+     * Bind the Draw block of object i from the last Upload.
+     */
+    void BindDraw(size_t i);
+
+private:
+    GLuint buffers[RING_SIZE];
+    size_t capacities[RING_SIZE];
+    unsigned int current;
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT rounds both up
+    size_t drawsOffset, drawStride;
+    std::vector<unsigned char> staging;
+};
+
+#endif //FRAMEUNIFORMS_H
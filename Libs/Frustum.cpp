@@ -0,0 +1,91 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_USE_SSE 1
+#endif
+
+void BoxList::Clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+    count = 0;
+}
+
+void BoxList::Add(const glm::vec3 &boxMin, const glm::vec3 &boxMax) {
+    glm::vec3 center = (boxMin + boxMax) * 0.5f;
+    glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+    if (count == centerX.size()) {
+        // grow by a whole SIMD lane group; the padding boxes are degenerate at the origin
+        size_t padded = count + 4;
+        for (std::vector<float> *lane : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+            lane->resize(padded, 0.0f);
+        }
+    }
+    centerX[count] = center.x;
+    centerY[count] = center.y;
+    centerZ[count] = center.z;
+    extentX[count] = extent.x;
+    extentY[count] = extent.y;
+    extentZ[count] = extent.z;
+    count++;
+}
+
+void CullBoxes(const Frustum &frustum, const BoxList &boxes, std::vector<unsigned char> &visible) {
+    visible.resize(boxes.count);
+
+#ifdef FRUSTUM_USE_SSE
+    // the box is outside a plane when dot(n, center) + d + dot(|n|, extent) < 0
+    __m128 normalX[6], normalY[6], normalZ[6], absX[6], absY[6], absZ[6], distance[6];
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4 &plane = frustum.planes[p];
+        normalX[p] = _mm_set1_ps(plane.x);
+        normalY[p] = _mm_set1_ps(plane.y);
+        normalZ[p] = _mm_set1_ps(plane.z);
+        absX[p] = _mm_set1_ps(std::fabs(plane.x));
+        absY[p] = _mm_set1_ps(std::fabs(plane.y));
+        absZ[p] = _mm_set1_ps(std::fabs(plane.z));
+        distance[p] = _mm_set1_ps(plane.w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for (size_t i = 0; i < boxes.count; i += 4) {
+        __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], cx), _mm_mul_ps(normalY[p], cy)),
+                                  _mm_add_ps(_mm_mul_ps(normalZ[p], cz), distance[p]));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)),
+                                  _mm_mul_ps(absZ[p], ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (size_t lane = 0; lane < 4 && i + lane < boxes.count; lane++) {
+            visible[i + lane] = (mask >> lane & 1) == 0;
+        }
+    }
+#else
+    for (size_t i = 0; i < boxes.count; i++) {
+        bool outside = false;
+        for (const glm::vec4 &plane : frustum.planes) {
+            float d = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i] + plane.z * boxes.centerZ[i] + plane.w;
+            float r = std::fabs(plane.x) * boxes.extentX[i] + std::fabs(plane.y) * boxes.extentY[i] +
+                      std::fabs(plane.z) * boxes.extentZ[i];
+            outside = outside || d + r < 0.0f;
+        }
+        visible[i] = !outside;
+    }
+#endif
+}
@@ -0,0 +1,75 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * The six clip planes of a projection, as (normal, distance) with normals pointing
+ * inwards, so a point p is inside when dot(normal, p) + distance >= 0 for every plane.
+ */
+struct Frustum {
+    glm::vec4 planes[6];
+
+    /**
+     * Extract the planes of clip = projection * view * model (Gribb-Hartmann).
+     * The planes live in whatever space clip's input is in, e.g. model space when
+     * the model matrix is included.
+     */
+    explicit Frustum(const glm::mat4 &clip) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            planes[i * 2] = rows[3] + rows[i];
+            planes[i * 2 + 1] = rows[3] - rows[i];
+        }
+        for (glm::vec4 &plane : planes) {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) {
+                plane /= length;
+            }
+        }
+    }
+
+    bool IsSphereOutside(const glm::vec3 &center, float radius) const {
+        for (const glm::vec4 &plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * World-space boxes stored structure-of-arrays as centres and half extents, so
+ * CullBoxes can test four of them per SIMD instruction.
+ */
+class BoxList {
+public:
+    void Clear();
+    void Add(const glm::vec3 &boxMin, const glm::vec3 &boxMax);
+    size_t GetCount() const { return count; }
+
+private:
+    friend void CullBoxes(const Frustum &frustum, const BoxList &boxes, std::vector<unsigned char> &visible);
+
+    // padded to a multiple of four so the SIMD loop needs no scalar tail
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    size_t count = 0;
+};
+
+/**
+ * Test every box against the frustum's six planes, four boxes at a time with SSE where
+ * available. A box is culled only if it lies entirely behind one plane, so the test is
+ * conservative near the frustum's corners.
+ * @param visible Resized to the box count; set to 1 for boxes that may be visible.
+ */
+void CullBoxes(const Frustum &frustum, const BoxList &boxes, std::vector<unsigned char> &visible);
+
+#endif //FRUSTUM_H
@@ -0,0 +1,149 @@
+#include "GeometryHeap.h"
+
+#include <algorithm>
+
+GeometryHeap *GeometryHeap::boundHeap = nullptr;
+std::vector<GeometryHeap *> GeometryHeap::heaps;
+
+// allocator offsets and sizes are 32-bit
+static const uint64_t MAX_UNITS = 0xFFFFFFFEu;
+
+GeometryHeap::GeometryHeap(size_t stride, void (*applyLayout)()) {
+    this->stride = stride;
+    this->applyLayout = applyLayout;
+    VAO = 0;
+    VBO = 0;
+    IBO = 0;
+    grows = 0;
+    heaps.push_back(this);
+}
+
+GeometryHeap::~GeometryHeap() {
+    if (VBO != 0) {
+        glDeleteBuffers(1, &VBO);
+    }
+    if (IBO != 0) {
+        glDeleteBuffers(1, &IBO);
+    }
+    if (VAO != 0) {
+        glDeleteVertexArrays(1, &VAO);
+    }
+    if (boundHeap == this) {
+        boundHeap = nullptr;
+    }
+    heaps.erase(std::remove(heaps.begin(), heaps.end(), this), heaps.end());
+}
+
+GeometryAllocation GeometryHeap::Allocate(const void *vertices, size_t vertexCount, const void *indices, size_t indexCount,
+                                          GLenum indexType) {
+    GeometryAllocation allocation;
+    allocation.indexType = indexType;
+    size_t indexBytes = indexCount * allocation.GetIndexSize();
+    if (vertexCount == 0 || indexCount == 0 || vertexCount > MAX_UNITS || indexBytes / 4 >= MAX_UNITS) {
+        return GeometryAllocation();
+    }
+    if (VAO == 0) {
+        glGenVertexArrays(1, &VAO);
+    }
+
+    GLuint oldVBO = VBO, oldIBO = IBO;
+    uint32_t vertexOffset = AllocateGrowing(vertexAllocator, static_cast<uint32_t>(vertexCount), INITIAL_VERTICES, stride, VBO);
+    if (vertexOffset == TlsfAllocator::INVALID_OFFSET) {
+        return GeometryAllocation();
+    }
+    uint32_t indexOffset = AllocateGrowing(indexAllocator, static_cast<uint32_t>((indexBytes + 3) / 4), INITIAL_INDEX_UNITS, 4, IBO);
+    if (indexOffset == TlsfAllocator::INVALID_OFFSET) {
+        vertexAllocator.Free(vertexOffset);
+        return GeometryAllocation();
+    }
+    if (VBO != oldVBO || IBO != oldIBO) {
+        SetupVertexArray();
+    }
+
+    allocation.vertexOffset = vertexOffset;
+    allocation.vertexCount = static_cast<uint32_t>(vertexCount);
+    allocation.indexOffset = indexOffset;
+    allocation.indexCount = static_cast<uint32_t>(indexCount);
+
+    // the copy target leaves the VAO's element buffer binding alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(vertexOffset) * stride, vertexCount * stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, IBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(indexOffset) * 4, indexBytes, indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return allocation;
+}
+
+void GeometryHeap::Free(GeometryAllocation &allocation) {
+    if (!allocation.IsValid()) {
+        return;
+    }
+    vertexAllocator.Free(allocation.vertexOffset);
+    indexAllocator.Free(allocation.indexOffset);
+    allocation = GeometryAllocation();
+}
+
+void GeometryHeap::Bind() {
+    if (boundHeap != this) {
+        glBindVertexArray(VAO);
+        boundHeap = this;
+    }
+}
+
+GeometryHeapStats GeometryHeap::GetStats() const {
+    GeometryHeapStats stats;
+    stats.vertexBytesUsed = size_t(vertexAllocator.GetUsed()) * stride;
+    stats.vertexBytesCapacity = size_t(vertexAllocator.GetCapacity()) * stride;
+    stats.indexBytesUsed = size_t(indexAllocator.GetUsed()) * 4;
+    stats.indexBytesCapacity = size_t(indexAllocator.GetCapacity()) * 4;
+    stats.allocations = vertexAllocator.GetAllocationCount();
+    stats.freeBlocks = vertexAllocator.GetFreeBlockCount() + indexAllocator.GetFreeBlockCount();
+    stats.grows = grows;
+    return stats;
+}
+
+GLuint GeometryHeap::ResizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes) {
+    GLuint resized;
+    glGenBuffers(1, &resized);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+    if (buffer != 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return resized;
+}
+
+uint32_t GeometryHeap::AllocateGrowing(TlsfAllocator &allocator, uint32_t size, uint32_t initialCapacity, size_t unitBytes,
+                                       GLuint &buffer) {
+    uint32_t offset = allocator.Allocate(size);
+    while (offset == TlsfAllocator::INVALID_OFFSET) {
+        uint64_t capacity = allocator.GetCapacity();
+        // double, and by at least size units; Grow extends the free block at the end, if any
+        uint64_t newCapacity = std::max<uint64_t>(capacity == 0 ? initialCapacity : capacity * 2, capacity + size);
+        newCapacity = std::min(newCapacity, MAX_UNITS);
+        if (newCapacity < capacity + size) {
+            return TlsfAllocator::INVALID_OFFSET;
+        }
+        buffer = ResizeBuffer(buffer, capacity * unitBytes, newCapacity * unitBytes);
+        allocator.Grow(static_cast<uint32_t>(newCapacity));
+        if (capacity > 0) {
+            grows++;
+        }
+        offset = allocator.Allocate(size);
+    }
+    return offset;
+}
+
+void GeometryHeap::SetupVertexArray() {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    applyLayout();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+    glBindVertexArray(0);
+    boundHeap = nullptr;
+}
@@ -0,0 +1,132 @@
+#ifndef GEOMETRYHEAP_H
+#define GEOMETRYHEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "TlsfAllocator.h"
+#include "VertexLayout.h"
+
+/**
+ * A mesh's place in a GeometryHeap. Indices are stored as the mesh gave them, so they
+ * stay relative to its first vertex and draws pass vertexOffset as the base vertex.
+ */
+struct GeometryAllocation {
+    uint32_t vertexOffset = TlsfAllocator::INVALID_OFFSET;
+    uint32_t vertexCount = 0;
+    // in 4-byte units, so 16- and 32-bit indices can share the index buffer
+    uint32_t indexOffset = TlsfAllocator::INVALID_OFFSET;
+    uint32_t indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    bool IsValid() const { return vertexOffset != TlsfAllocator::INVALID_OFFSET; }
+    size_t GetIndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+    // glDrawElements* offset of the allocation's index firstIndex
+    const void *GetIndexPointer(uint32_t firstIndex) const {
+        return reinterpret_cast<const void *>(size_t(indexOffset) * 4 + firstIndex * GetIndexSize());
+    }
+};
+
+/**
+ * One draw out of a heap, in the terms of DrawElementsIndirectCommand.
+ */
+struct DrawRange {
+    GLuint indexCount;
+    // counted in indices from the start of the heap's index buffer
+    GLuint firstIndex;
+    GLint baseVertex;
+};
+
+struct GeometryHeapStats {
+    size_t vertexBytesUsed = 0, vertexBytesCapacity = 0;
+    size_t indexBytesUsed = 0, indexBytesCapacity = 0;
+    size_t allocations = 0;
+    // free blocks across both buffers; many small ones mean fragmentation
+    size_t freeBlocks = 0;
+    unsigned int grows = 0;
+};
+
+/**
+ * Shared vertex and index buffers for every mesh of one vertex format, split up by
+ * TlsfAllocator. All meshes draw under one VAO with glDrawElementsBaseVertex, so moving
+ * from mesh to mesh binds nothing, and freed space is reused by later meshes. The
+ * buffers double when full; their contents are copied across on the GPU.
+ */
+class GeometryHeap {
+public:
+    /**
+     * The heap for a vertex format, created on first use, so only once a GL context exists.
+     */
+    template <typename Vertex>
+    static GeometryHeap &Get() {
+        static GeometryHeap heap(sizeof(Vertex), &ApplyVertexLayout<Vertex>);
+        return heap;
+    }
+
+    ~GeometryHeap();
+    GeometryHeap(const GeometryHeap &) = delete;
+    GeometryHeap &operator=(const GeometryHeap &) = delete;
+
+    /**
+     * Copy a mesh's vertices (stride bytes each) and indices into the heap.
+     * @return an invalid allocation if the buffers cannot grow large enough.
+     */
+    GeometryAllocation Allocate(const void *vertices, size_t vertexCount, const void *indices, size_t indexCount,
+                                GLenum indexType);
+
+    /**
+     * Return an allocation's space to the heap and reset it.
+     */
+    void Free(GeometryAllocation &allocation);
+
+    /**
+     * Bind the heap's VAO unless a draw from this heap already did.
+     */
+    void Bind();
+
+    /**
+     * Forget which VAO is bound; call after binding any VAO outside a heap.
+     */
+    static void InvalidateBinding() { boundHeap = nullptr; }
+
+    static DrawRange GetDrawRange(const GeometryAllocation &allocation, uint32_t firstIndex, uint32_t indexCount) {
+        return DrawRange{indexCount, static_cast<GLuint>(size_t(allocation.indexOffset) * 4 / allocation.GetIndexSize()) + firstIndex,
+                         static_cast<GLint>(allocation.vertexOffset)};
+    }
+
+    GeometryHeapStats GetStats() const;
+    size_t GetStride() const { return stride; }
+
+    /**
+     * Every heap created so far, one per vertex format in use.
+     */
+    static const std::vector<GeometryHeap *> &GetHeaps() { return heaps; }
+
+private:
+    // starting sizes, in vertices and 4-byte index units
+    static const uint32_t INITIAL_VERTICES = 1u << 18;
+    static const uint32_t INITIAL_INDEX_UNITS = 1u << 20;
+
+    static GeometryHeap *boundHeap;
+    static std::vector<GeometryHeap *> heaps;
+
+    size_t stride;
+    void (*applyLayout)();
+    GLuint VAO, VBO, IBO;
+    TlsfAllocator vertexAllocator, indexAllocator;
+    unsigned int grows;
+
+    GeometryHeap(size_t stride, void (*applyLayout)());
+
+    // move a buffer's contents into a new one of newBytes
+    static GLuint ResizeBuffer(GLuint buffer, size_t oldBytes, size_t newBytes);
+    // allocate from allocator, growing it and its buffer until size units fit
+    uint32_t AllocateGrowing(TlsfAllocator &allocator, uint32_t size, uint32_t initialCapacity, size_t unitBytes,
+                             GLuint &buffer);
+    void SetupVertexArray();
+};
+
+#endif //GEOMETRYHEAP_H
@@ -0,0 +1,234 @@
+#include "HiZCuller.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+static const char *REDUCE_SHADER = "Shaders/hiz_reduce.comp";
+static const char *CULL_SHADER = "Shaders/hiz_cull.comp";
+// local sizes declared in the shaders
+static const int REDUCE_GROUP_SIZE = 8;
+static const GLuint CULL_GROUP_SIZE = 64;
+
+HiZCuller::HiZCuller() {
+    ready = false;
+    width = 0;
+    height = 0;
+    pyramidLevels = 0;
+    depthTexture = 0;
+    pyramidTexture = 0;
+    objectBuffer = 0;
+    visibilityBuffer = 0;
+    earlyCommandBuffer = 0;
+    lateCommandBuffer = 0;
+    statsBuffer = 0;
+}
+
+HiZCuller::~HiZCuller() {
+    Release();
+}
+
+bool HiZCuller::IsSupported() {
+    return GLEW_VERSION_4_3;
+}
+
+bool HiZCuller::Initialise(int width, int height) {
+    Release();
+    if (!IsSupported()) {
+        std::cout << "Hi-Z culling needs OpenGL 4.3, using the CPU culling path" << std::endl;
+        return false;
+    }
+
+    reduceShader.CreateComputeFromFile(REDUCE_SHADER);
+    cullShader.CreateComputeFromFile(CULL_SHADER);
+    if (!reduceShader.IsValid() || !cullShader.IsValid()) {
+        std::cout << "Hi-Z culling shaders failed to build, using the CPU culling path" << std::endl;
+        Release();
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    pyramidLevels = 1;
+    while ((std::max(width, height) >> pyramidLevels) > 0) {
+        pyramidLevels++;
+    }
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glGenTextures(1, &pyramidTexture);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &objectBuffer);
+    glGenBuffers(1, &visibilityBuffer);
+    glGenBuffers(1, &earlyCommandBuffer);
+    glGenBuffers(1, &lateCommandBuffer);
+    glGenBuffers(1, &statsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(HiZStats), nullptr, GL_DYNAMIC_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    std::cout << "Hi-Z culling ready: " << width << "x" << height << " pyramid, " << pyramidLevels << " levels" << std::endl;
+    ready = true;
+    objects.clear();
+    return true;
+}
+
+void HiZCuller::Release() {
+    if (depthTexture != 0) {
+        glDeleteTextures(1, &depthTexture);
+        depthTexture = 0;
+    }
+    if (pyramidTexture != 0) {
+        glDeleteTextures(1, &pyramidTexture);
+        pyramidTexture = 0;
+    }
+    for (GLuint *buffer : {&objectBuffer, &visibilityBuffer, &earlyCommandBuffer, &lateCommandBuffer, &statsBuffer}) {
+        if (*buffer != 0) {
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+    }
+    reduceShader.ClearShader();
+    cullShader.ClearShader();
+    objects.clear();
+    ready = false;
+}
+
+void HiZCuller::SetObjectCount(size_t count) {
+    if (!ready || count == objects.size()) {
+        return;
+    }
+    objects.assign(count, CullObject());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(count, 1) * sizeof(CullObject), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    Reset();
+}
+
+void HiZCuller::Reset() {
+    if (!ready) {
+        return;
+    }
+    size_t count = std::max<size_t>(objects.size(), 1);
+    // nothing visible and nothing to draw early; the next Cull re-populates both
+    std::vector<GLuint> visibility(count, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibilityBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), visibility.data(), GL_DYNAMIC_COPY);
+    std::vector<DrawCommand> commands(count, DrawCommand());
+    for (GLuint buffer : {earlyCommandBuffer, lateCommandBuffer}) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(DrawCommand), commands.data(), GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void HiZCuller::SetObject(size_t i, const Bounds &worldBounds, const DrawRange &draw) {
+    CullObject &object = objects[i];
+    object.boxMin = glm::vec4(worldBounds.boxMin, 1.0f);
+    object.boxMax = glm::vec4(worldBounds.boxMax, 1.0f);
+    object.indexCount = draw.indexCount;
+    object.firstIndex = draw.firstIndex;
+    object.baseVertex = draw.baseVertex;
+}
+
+void HiZCuller::BindEarlyCommands() {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, earlyCommandBuffer);
+}
+
+void HiZCuller::BindLateCommands() {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, lateCommandBuffer);
+}
+
+void HiZCuller::UnbindCommands() {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+const void *HiZCuller::GetCommandOffset(size_t i) const {
+    return reinterpret_cast<const void *>(static_cast<uintptr_t>(i * sizeof(DrawCommand)));
+}
+
+void HiZCuller::BuildPyramid() {
+    if (!ready) {
+        return;
+    }
+    // depth of the early pass, straight from the default framebuffer
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    reduceShader.UseShader();
+    reduceShader.SetUniform("depthBuffer", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    int levelWidth = width, levelHeight = height;
+    for (int level = 0; level < pyramidLevels; level++) {
+        // level 0 is a copy; each later level halves the one before, rounding down
+        int sourceWidth = levelWidth, sourceHeight = levelHeight;
+        if (level > 0) {
+            levelWidth = std::max(1, levelWidth / 2);
+            levelHeight = std::max(1, levelHeight / 2);
+            glBindImageTexture(1, pyramidTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+        }
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        reduceShader.SetUniform("fromDepthBuffer", GLint(level == 0));
+        reduceShader.SetUniform("sourceSize", glm::ivec2(sourceWidth, sourceHeight));
+        glDispatchCompute((levelWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE,
+                          (levelHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void HiZCuller::Cull(const glm::mat4 &viewProjection) {
+    if (!ready || objects.empty()) {
+        return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, objects.size() * sizeof(CullObject), objects.data());
+    HiZStats zero;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(HiZStats), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibilityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, earlyCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, lateCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, statsBuffer);
+
+    cullShader.UseShader();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    cullShader.SetUniform("depthPyramid", 0);
+    cullShader.SetUniform("viewProjection", viewProjection);
+    cullShader.SetUniform("objectCount", static_cast<GLuint>(objects.size()));
+    cullShader.SetUniform("pyramidLevels", pyramidLevels);
+    glDispatchCompute((static_cast<GLuint>(objects.size()) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+HiZStats HiZCuller::ReadStats() {
+    HiZStats stats;
+    if (!ready) {
+        return stats;
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(HiZStats), &stats);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return stats;
+}
@@ -0,0 +1,119 @@
+#ifndef HIZCULLER_H
+#define HIZCULLER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "GeometryHeap.h"
+#include "Shader.h"
+
+/**
+ * Counters written by the cull pass of one frame.
+ */
+struct HiZStats {
+    GLuint tested = 0;
+    GLuint frustumCulled = 0;
+    GLuint occluded = 0;
+    GLuint newlyVisible = 0;
+};
+
+/**
+ * Two-phase hierarchical-Z occlusion culling on the GPU, for OpenGL 4.3 contexts.
+ *
+ * Each frame the objects found visible last frame are drawn first from the early command
+ * buffer. Their depth is reduced into a max-depth mip pyramid by a compute shader, and a
+ * second compute pass tests every object's box against it. That pass writes one indirect
+ * draw command per object into two buffers: the late buffer draws objects that are visible
+ * now but were not drawn early, and the early buffer is next frame's first pass. Object i
+ * always uses command i, drawn with its mesh's RenderIndirect(GetCommandOffset(i)).
+ */
+class HiZCuller {
+public:
+    HiZCuller();
+    ~HiZCuller();
+
+    HiZCuller(const HiZCuller &) = delete;
+    HiZCuller &operator=(const HiZCuller &) = delete;
+
+    /**
+     * True if the current context has compute shaders and indirect draws.
+     */
+    static bool IsSupported();
+
+    /**
+     * Load the compute shaders and size the pyramid to the framebuffer.
+     * @return false if the context is older than 4.3 or a shader failed to build.
+     */
+    bool Initialise(int width, int height);
+    bool IsReady() const { return ready; }
+
+    /**
+     * Size the per-object buffers. Changing the count, like Reset, marks every object as
+     * not drawn early, so the late pass picks up whatever is visible.
+     */
+    void SetObjectCount(size_t count);
+    void Reset();
+
+    /**
+     * World box and geometry heap range the cull pass writes into object i's commands.
+     */
+    void SetObject(size_t i, const Bounds &worldBounds, const DrawRange &draw);
+
+    /**
+     * Bind the early or late command buffer as GL_DRAW_INDIRECT_BUFFER.
+     */
+    void BindEarlyCommands();
+    void BindLateCommands();
+    void UnbindCommands();
+    const void *GetCommandOffset(size_t i) const;
+
+    /**
+     * Copy the framebuffer's depth and reduce it into the pyramid.
+     */
+    void BuildPyramid();
+
+    /**
+     * Test every object against the pyramid and rewrite both command buffers.
+     */
+    void Cull(const glm::mat4 &viewProjection);
+
+    /**
+     * Read back the last Cull's counters. Waits for the GPU, so call it sparingly.
+     */
+    HiZStats ReadStats();
+
+private:
+    // std430 layout of CullObject in hiz_cull.comp
+    struct CullObject {
+        glm::vec4 boxMin;
+        glm::vec4 boxMax;
+        GLuint indexCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint padding;
+    };
+
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    bool ready;
+    int width, height, pyramidLevels;
+    GLuint depthTexture, pyramidTexture;
+    GLuint objectBuffer, visibilityBuffer, earlyCommandBuffer, lateCommandBuffer, statsBuffer;
+    Shader reduceShader, cullShader;
+    std::vector<CullObject> objects;
+
+    void Release();
+};
+
+#endif //HIZCULLER_H
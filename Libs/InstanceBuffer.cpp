@@ -0,0 +1,69 @@
+#include "InstanceBuffer.h"
+
+InstanceBuffer::InstanceBuffer(const std::vector<glm::mat4> &transforms) : transforms(transforms) {
+    glGenBuffers(1, &buffer);
+}
+
+InstanceBuffer::~InstanceBuffer() {
+    if (buffer != 0) {
+        glDeleteBuffers(1, &buffer);
+    }
+}
+
+Bounds InstanceBuffer::Place(const glm::mat4 &model, const Bounds &meshBounds) {
+    instanceBounds.resize(transforms.size());
+    instanceBoxes.Clear();
+    Bounds all;
+    for (size_t i = 0; i < transforms.size(); i++) {
+        instanceBounds[i] = TransformBounds(meshBounds, transforms[i] * model);
+        instanceBoxes.Add(instanceBounds[i].boxMin, instanceBounds[i].boxMax);
+        all.boxMin = i == 0 ? instanceBounds[i].boxMin : glm::min(all.boxMin, instanceBounds[i].boxMin);
+        all.boxMax = i == 0 ? instanceBounds[i].boxMax : glm::max(all.boxMax, instanceBounds[i].boxMax);
+    }
+    all.sphereCenter = all.GetBoxCenter();
+    all.sphereRadius = glm::length(all.GetBoxExtent()) * 0.5f;
+    return all;
+}
+
+GLsizei InstanceBuffer::Cull(const Frustum &frustum) {
+    CullBoxes(frustum, instanceBoxes, instanceVisible);
+    visibleMatrices.clear();
+    for (size_t i = 0; i < transforms.size(); i++) {
+        if (instanceVisible[i]) {
+            // the shader applies the model matrix itself, from the model's Draw block
+            visibleMatrices.push_back(transforms[i]);
+        }
+    }
+    if (!visibleMatrices.empty()) {
+        // orphan last frame's matrices rather than wait for the GPU to finish with them
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, visibleMatrices.size() * sizeof(glm::mat4), visibleMatrices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    return GetVisibleCount();
+}
+
+void InstanceBuffer::Bind() const {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(MATRIX_LOCATION + column);
+        glVertexAttribPointer(MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              reinterpret_cast<const void *>(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(MATRIX_LOCATION + column, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceBuffer::Unbind() {
+    for (GLuint column = 0; column < 4; column++) {
+        glDisableVertexAttribArray(MATRIX_LOCATION + column);
+    }
+    SetIdentity();
+}
+
+void InstanceBuffer::SetIdentity() {
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttrib4f(MATRIX_LOCATION + column, column == 0 ? 1.0f : 0.0f, column == 1 ? 1.0f : 0.0f,
+                         column == 2 ? 1.0f : 0.0f, column == 3 ? 1.0f : 0.0f);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+/**
+ * Placements of one mesh drawn many times by a single glDrawElementsInstanced. Each
+ * frame Place puts every instance under the model's own matrix to find its bounds, and
+ * Cull uploads the placements of the instances in view, which the vertex shader reads as
+ * a per-instance mat4 attribute and applies after the model matrix. Draws without
+ * instances read one identity matrix instead.
+ */
+class InstanceBuffer {
+public:
+    // the instance matrix takes this attribute location and the next three, one per column
+    static const GLuint MATRIX_LOCATION = 3;
+
+    /**
+     * @param transforms World-space placements, applied after the model matrix.
+     */
+    explicit InstanceBuffer(const std::vector<glm::mat4> &transforms);
+    ~InstanceBuffer();
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    size_t GetInstanceCount() const { return transforms.size(); }
+
+    /**
+     * Place every instance under model.
+     * @return the bounds around all the instances.
+     */
+    Bounds Place(const glm::mat4 &model, const Bounds &meshBounds);
+    // each instance's world bounds as of the last Place
+    const std::vector<Bounds> &GetInstanceBounds() const { return instanceBounds; }
+
+    /**
+     * Upload the placements of the instances inside the frustum.
+     * @return how many there are, the instance count to draw.
+     */
+    GLsizei Cull(const Frustum &frustum);
+    GLsizei GetVisibleCount() const { return static_cast<GLsizei>(visibleMatrices.size()); }
+
+    /**
+     * Point the instance matrix attributes of the bound VAO at the uploaded matrices.
+     */
+    void Bind() const;
+
+    /**
+     * Turn the instance attributes of the bound VAO off again and restore the identity
+     * matrix, which a draw with them on leaves undefined.
+     */
+    static void Unbind();
+
+    /**
+     * Set the matrix that draws without instances read. GL's default is not identity, so
+     * call it once before the first draw.
+     */
+    static void SetIdentity();
+
+private:
+    GLuint buffer;
+    std::vector<glm::mat4> transforms;
+    std::vector<Bounds> instanceBounds;
+    BoxList instanceBoxes;
+    std::vector<unsigned char> instanceVisible;
+    std::vector<glm::mat4> visibleMatrices;
+};
+
+#endif //INSTANCEBUFFER_H
@@ -0,0 +1,35 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+
+/**
+ * Read-only memory mapping of a whole file. The contents stay valid until
+ * Close() is called or the object is destroyed, and are never copied.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const char *path);
+    void Close();
+
+    const char *GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#else
+    int fd;
+#endif
+};
+
+#endif //MAPPEDFILE_H
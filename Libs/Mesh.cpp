@@ -1,188 +1,317 @@
 #include "Mesh.h"
+#include "MeshEncoding.h"
+#include "MeshOptimizer.h"
+#include "Frustum.h"
+
+#include <algorithm>
+#include <chrono>
+
+MeshLoadOptions Mesh::loadOptions;
+
+// bits of the mesh cache key describing how the cached mesh was processed
+enum MeshProcessingFlags : uint32_t {
+    MESH_OPTIMIZED_VERTEX_CACHE = 1u << 0,
+    MESH_OPTIMIZED_OVERDRAW = 1u << 1,
+    MESH_GENERATED_LODS = 1u << 2,
+    // bits 8-19 hold the overdraw threshold in hundredths
+    MESH_OVERDRAW_THRESHOLD_SHIFT = 8,
+    // bits 32-63 hold a hash of the LOD targets
+    MESH_LOD_TARGETS_SHIFT = 32,
+};
+
+static double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+static double ThroughputMBs(size_t bytes, double ms) {
+    return ms > 0.0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0;
+}
 
 Mesh::Mesh() {
-    VAO = 0;
-    VBO = 0;
-    IBO = 0;
-    vertexBuffer = 0;
-    uvBuffer = 0;
-    normalBuffer = 0;
+    heap = nullptr;
     indexCount = 0;
+    positionScale = glm::vec3(1.0f);
+    positionOffset = glm::vec3(0.0f);
+    octahedralNormals = false;
+    buildOccluder = false;
 }
 
 Mesh::~Mesh() {
     ClearMesh();
 }
 
-void Mesh::CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numOfVertices, unsigned int numOfIndices) {
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-
-    glGenBuffers(1, &IBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
-
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+static_assert(sizeof(VertexPT) == 5 * sizeof(GLfloat), "VertexPT must match the packed 5-float layout");
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    glBindVertexArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+void Mesh::CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numOfVertices, unsigned int numOfIndices) {
+    // numOfVertices counts floats: 3 position + 2 texture coordinate per vertex
+    CreateMesh(reinterpret_cast<const VertexPT *>(vertices), indices, numOfVertices / 5, numOfIndices);
 }
 
-void Mesh::RenderMesh() {
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+void Mesh::RenderMesh(unsigned int lod) {
+    if (lods.empty()) {
+        return;
+    }
+    const MeshLod &range = lods[std::min<size_t>(lod, lods.size() - 1)];
 
-    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    heap->Bind();
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, allocation.indexType,
+                             allocation.GetIndexPointer(range.indexOffset), allocation.vertexOffset);
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+void Mesh::RenderInstanced(unsigned int lod, const InstanceBuffer &instances) {
+    if (lods.empty() || instances.GetVisibleCount() == 0) {
+        return;
+    }
+    const MeshLod &range = lods[std::min<size_t>(lod, lods.size() - 1)];
+
+    heap->Bind();
+    instances.Bind();
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, allocation.indexType,
+                                      allocation.GetIndexPointer(range.indexOffset), instances.GetVisibleCount(),
+                                      allocation.vertexOffset);
+    InstanceBuffer::Unbind();
 }
 
-void Mesh::ClearMesh() {
-    if (vertexBuffer != 0) {
-        glDeleteBuffers(1, &vertexBuffer);
-        vertexBuffer = 0;
+void Mesh::RenderIndirect(const void *command) {
+    if (lods.empty()) {
+        return;
     }
+    heap->Bind();
+    glDrawElementsIndirect(GL_TRIANGLES, allocation.indexType, command);
+}
 
-    if (uvBuffer != 0) {
-        glDeleteBuffers(1, &uvBuffer);
-        uvBuffer = 0;
+void Mesh::RenderMeshlets(const glm::mat4 &model, const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition,
+                          bool coneCulling, MeshletCullStats &stats) {
+    if (meshlets.empty()) {
+        RenderMesh();
+        stats.trianglesDrawn += lods.empty() ? 0 : lods[0].indexCount / 3;
+        return;
     }
 
-    if (normalBuffer != 0) {
-        glDeleteBuffers(1, &normalBuffer);
-        normalBuffer = 0;
+    // cull in model space so the meshlet bounds never need transforming
+    Frustum frustum(viewProjection * model);
+    glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+    size_t indexSize = allocation.GetIndexSize();
+
+    drawCounts.clear();
+    drawOffsets.clear();
+    for (const Meshlet &meshlet : meshlets) {
+        stats.tested++;
+        if (frustum.IsSphereOutside(meshlet.center, meshlet.radius)) {
+            stats.frustumCulled++;
+            continue;
+        }
+        if (coneCulling && IsMeshletBackfacing(meshlet, localCamera)) {
+            stats.backfaceCulled++;
+            continue;
+        }
+        stats.trianglesDrawn += meshlet.triangleCount;
+
+        // meshlets are consecutive index ranges, so neighbours merge into one draw
+        GLsizei count = meshlet.triangleCount * 3;
+        const char *offset = static_cast<const char *>(allocation.GetIndexPointer(meshlet.indexOffset));
+        if (!drawCounts.empty() &&
+            static_cast<const char *>(drawOffsets.back()) + drawCounts.back() * indexSize == offset) {
+            drawCounts.back() += count;
+        } else {
+            drawCounts.push_back(count);
+            drawOffsets.push_back(offset);
+        }
     }
 
-    if (IBO != 0) {
-        glDeleteBuffers(1, &IBO);
-        IBO = 0;
+    if (drawCounts.empty()) {
+        return;
     }
 
-    if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
-        VAO = 0;
+    drawBaseVertices.assign(drawCounts.size(), static_cast<GLint>(allocation.vertexOffset));
+    heap->Bind();
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), allocation.indexType, drawOffsets.data(),
+                                  static_cast<GLsizei>(drawCounts.size()), drawBaseVertices.data());
+}
+
+void Mesh::ClearMesh() {
+    if (heap != nullptr) {
+        // the space goes back to the heap for the next mesh streamed in
+        heap->Free(allocation);
+        heap = nullptr;
     }
 
     indexCount = 0;
+    lods.clear();
+    meshlets.clear();
+    occluder = OccluderMesh();
 }
 
-bool Mesh::CreateMeshFromOBJ(const char *path) {
-    std::vector<glm::vec3> tempVertices;
-    std::vector<glm::vec2> tempTexCoords;
-    std::vector<glm::vec3> tempNormals;
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    std::vector<Face> faces;
-
-    std::ifstream file(path);
-    if (!file.is_open()) {
+bool Mesh::CreateMeshFromOBJ(const char *path, bool keepOccluder) {
+    auto loadStart = std::chrono::steady_clock::now();
+    buildOccluder = keepOccluder;
+
+    MeshSourceKey sourceKey;
+    if (!MeshCache::ComputeSourceKey(path, sourceKey)) {
         std::cerr << "Error: could not open " << path << std::endl;
         return false;
     }
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.substr(0, 2) == "v ") {
-            glm::vec3 vertex;
-            sscanf(line.c_str(), "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            tempVertices.push_back(vertex);
-        } else if (line.substr(0, 3) == "vt ") {
-            glm::vec2 texCoord;
-            sscanf(line.c_str(), "vt %f %f", &texCoord.x, &texCoord.y);
-            tempTexCoords.push_back(texCoord);
-        } else if (line.substr(0, 3) == "vn ") {
-            glm::vec3 normal;
-            sscanf(line.c_str(), "vn %f %f %f", &normal.x, &normal.y, &normal.z);
-            tempNormals.push_back(normal);
-        } else if (line.substr(0, 2) == "f ") {
-            Face face;
-            sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &face.vIndex[0], &face.vtIndex[0], &face.vnIndex[0],
-                     &face.vIndex[1], &face.vtIndex[1], &face.vnIndex[1], &face.vIndex[2], &face.vtIndex[2], &face.vnIndex[2]);
-            faces.push_back(face);
+    std::string cachePath = MeshCache::GetCachePath(path);
+
+    uint64_t flags = GetProcessingFlags();
+
+    // warm path: map the cache blob and upload straight from the mapping
+    MeshCache cache;
+    if (loadOptions.useCache && cache.Open(cachePath.c_str(), sourceKey, flags)) {
+        auto mapEnd = std::chrono::steady_clock::now();
+        const MeshView &view = cache.GetView();
+        UploadMesh(view);
+        auto uploadEnd = std::chrono::steady_clock::now();
+
+        std::cout << "Unique vertices: " << view.vertexCount << ", indices: " << indexCount << std::endl;
+        std::cout << "Load time (warm, " << cachePath << "): hash+map " << ElapsedMs(loadStart, mapEnd)
+                  << " ms, upload " << ElapsedMs(mapEnd, uploadEnd)
+                  << " ms, total " << ElapsedMs(loadStart, uploadEnd) << " ms" << std::endl;
+        return true;
+    }
+
+    auto hashEnd = std::chrono::steady_clock::now();
+
+    ObjData obj;
+    if (!ParseOBJ(path, obj, loadOptions.parseThreads)) {
+        std::cerr << "Error: could not open " << path << std::endl;
+        return false;
+    }
+    std::cout << "Vertices: " << obj.positions.size() << std::endl;
+
+    auto parseEnd = std::chrono::steady_clock::now();
+
+    MeshData mesh;
+    BuildMeshData(obj, mesh);
+
+    auto dedupEnd = std::chrono::steady_clock::now();
+
+    if (loadOptions.optimizeVertexCache) {
+        VertexCacheStats before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+        VertexCacheStats after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        std::cout << "Vertex cache: ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr
+                  << " (" << ElapsedMs(dedupEnd, std::chrono::steady_clock::now()) << " ms)" << std::endl;
+
+        if (loadOptions.overdrawThreshold > 0.0f) {
+            OverdrawStats overdrawBefore = AnalyzeOverdraw(mesh.vertices, mesh.indices);
+            OptimizeOverdraw(mesh.indices, mesh.vertices, loadOptions.overdrawThreshold);
+            OverdrawStats overdrawAfter = AnalyzeOverdraw(mesh.vertices, mesh.indices);
+            VertexCacheStats overdrawCache = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+            std::cout << "Overdraw: " << overdrawBefore.overdraw << " -> " << overdrawAfter.overdraw
+                      << " shaded/covered, ACMR " << after.acmr << " -> " << overdrawCache.acmr
+                      << " (threshold " << loadOptions.overdrawThreshold << ")" << std::endl;
         }
+
+        OptimizeVertexFetch(mesh);
     }
-    file.close();
-    std::cout << "Vertices: " << tempVertices.size() << std::endl;
-
-    std::vector<unsigned int> indices;
-
-    // std::cout << "Estimate indices: " << faces.size() * 3 << std::endl;
-    std::unordered_map<std::string, int> vertexToIndex;
-
-    for (Face face : faces) {
-        for (int i = 0; i < 3; i++) {
-            glm::vec3 currVertex = tempVertices[face.vIndex[i] - 1];
-            glm::vec2 currTexCoord = tempTexCoords[face.vtIndex[i] - 1];
-            glm::vec3 currNormal = tempNormals[face.vnIndex[i] - 1];
-
-            std::stringstream ss;
-            ss << currVertex.x << currVertex.y << currVertex.z
-               << currTexCoord.x << currTexCoord.y
-               << currNormal.x << currNormal.y << currNormal.z;
-            std::string vertexKey = ss.str();
-
-            if (vertexToIndex.count(vertexKey)) {
-                indices.push_back(vertexToIndex[vertexKey]);
-            } else {
-                int newIndex = vertices.size();
-                vertexToIndex[vertexKey] = newIndex;
-                indices.push_back(newIndex);
-                vertices.push_back(currVertex);
-                texCoords.push_back(currTexCoord);
-                normals.push_back(currNormal);
-            }
+
+    auto optimizeEnd = std::chrono::steady_clock::now();
+
+    if (!loadOptions.lodTargets.empty()) {
+        GenerateMeshLods(mesh, loadOptions.lodTargets);
+        for (size_t i = 1; i < mesh.lods.size(); i++) {
+            std::cout << "LOD " << i << ": " << mesh.lods[i].indexCount / 3 << " triangles ("
+                      << 100.0f * mesh.lods[i].indexCount / mesh.lods[0].indexCount << "%), error "
+                      << mesh.lods[i].error * 100.0f << "% of extent" << std::endl;
         }
-        // std::cout << "Indices: " << indices.size() << std::endl;
     }
 
-    indexCount = indices.size();
+    auto lodEnd = std::chrono::steady_clock::now();
 
-    // Create and bind the VAO
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    if (loadOptions.useCache && !MeshCache::Write(cachePath.c_str(), sourceKey, flags, mesh)) {
+        std::cout << "Could not write mesh cache " << cachePath << std::endl;
+    }
+
+    auto cacheEnd = std::chrono::steady_clock::now();
+
+    UploadMesh(MakeMeshView(mesh));
 
-    // Create the VBO for vertex positions
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+    auto uploadEnd = std::chrono::steady_clock::now();
+    std::cout << "Unique vertices: " << mesh.vertices.size() << ", indices: " << indexCount << std::endl;
+    double parseMs = ElapsedMs(hashEnd, parseEnd);
+    std::cout << "Load time (cold): hash " << ElapsedMs(loadStart, hashEnd)
+              << " ms, parse " << parseMs << " ms (" << ThroughputMBs(obj.sourceBytes, parseMs)
+              << " MB/s), dedup " << ElapsedMs(parseEnd, dedupEnd)
+              << " ms, optimize " << ElapsedMs(dedupEnd, optimizeEnd)
+              << " ms, lod " << ElapsedMs(optimizeEnd, lodEnd)
+              << " ms, cache write " << ElapsedMs(lodEnd, cacheEnd)
+              << " ms, upload " << ElapsedMs(cacheEnd, uploadEnd)
+              << " ms, total " << ElapsedMs(loadStart, uploadEnd) << " ms" << std::endl;
+
+    return true;
+}
 
-    // Create the VBO for texture coordinates
-    glGenBuffers(1, &uvBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, texCoords.size() * sizeof(glm::vec2), &texCoords[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)0);
+uint64_t Mesh::GetProcessingFlags() {
+    uint64_t flags = 0;
+    if (loadOptions.optimizeVertexCache) {
+        flags |= MESH_OPTIMIZED_VERTEX_CACHE;
+        if (loadOptions.overdrawThreshold > 0.0f) {
+            uint32_t threshold = static_cast<uint32_t>(loadOptions.overdrawThreshold * 100.0f + 0.5f) & 0xFFFu;
+            flags |= MESH_OPTIMIZED_OVERDRAW | threshold << MESH_OVERDRAW_THRESHOLD_SHIFT;
+        }
+    }
+    if (!loadOptions.lodTargets.empty()) {
+        // FNV-1a over the targets, so changing any level invalidates cached LODs
+        uint32_t hash = 2166136261u;
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(loadOptions.lodTargets.data());
+        for (size_t i = 0; i < loadOptions.lodTargets.size() * sizeof(LodTarget); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        flags |= MESH_GENERATED_LODS | uint64_t(hash) << MESH_LOD_TARGETS_SHIFT;
+    }
+    return flags;
+}
 
-    // Create the VBO for normals
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+void Mesh::UploadMesh(const MeshView &mesh) {
+    bounds = mesh.bounds;
+
+    if (loadOptions.buildMeshlets) {
+        // built from the full mesh's final index order, so the index buffer needs no reordering
+        MeshView full = mesh;
+        full.indexCount = mesh.GetFullIndexCount();
+        meshlets = BuildMeshlets(full);
+        MeshletStats stats = AnalyzeMeshlets(meshlets);
+        std::cout << "Meshlets: " << stats.meshletCount << " clusters, " << stats.averageVertices
+                  << " vertices (" << stats.vertexFill * 100.0f << "% full), " << stats.averageTriangles
+                  << " triangles (" << stats.triangleFill * 100.0f << "% full) per cluster" << std::endl;
+    }
 
-    // Create the IBO
-    glGenBuffers(1, &IBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+    if (buildOccluder) {
+        occluder = BuildOccluderMesh(mesh, loadOptions.occluderMaxError);
+        std::cout << "Occluder: " << occluder.indices.size() / 3 << " triangles, "
+                  << occluder.positions.size() << " vertices" << std::endl;
+    }
 
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    if (!loadOptions.compactVertices) {
+        CreateMesh(mesh.vertices, mesh.indices, mesh.vertexCount, mesh.indexCount);
+        SetLods(mesh);
+        return;
+    }
 
-    // Unbind the VAO, VBO, and IBO
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    CompactMesh compact;
+    EncodeCompactMesh(mesh, compact);
+    if (compact.shortIndices) {
+        CreateMesh(compact.vertices.data(), compact.indices16.data(), compact.vertices.size(), compact.indices16.size());
+    } else {
+        CreateMesh(compact.vertices.data(), mesh.indices, compact.vertices.size(), mesh.indexCount);
+    }
+    SetLods(mesh);
+    positionScale = compact.positionScale;
+    positionOffset = compact.positionOffset;
+    octahedralNormals = true;
+
+    size_t fullBytes = mesh.vertexCount * sizeof(VertexPTN) + mesh.indexCount * sizeof(unsigned int);
+    size_t compactBytes = mesh.vertexCount * sizeof(VertexCompact) +
+                          mesh.indexCount * (compact.shortIndices ? sizeof(uint16_t) : sizeof(unsigned int));
+    std::cout << "Compact vertices: " << fullBytes / 1024.0 << " KB -> " << compactBytes / 1024.0
+              << " KB of VRAM (saved " << (fullBytes - compactBytes) / 1024.0 << " KB, "
+              << (compact.shortIndices ? "16" : "32") << "-bit indices)" << std::endl;
+}
 
-    return true;
+void Mesh::SetLods(const MeshView &mesh) {
+    if (mesh.lodCount > 0) {
+        lods.assign(mesh.lods, mesh.lods + mesh.lodCount);
+    }
 }
@@ -16,8 +16,37 @@
 #include <string.h>
 #include <unordered_map>
 
-struct Face {
-    int vIndex[3], vtIndex[3], vnIndex[3];
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexLayout.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "OcclusionCuller.h"
+#include "GeometryHeap.h"
+#include "InstanceBuffer.h"
+
+/**
+ * Processing applied by Mesh::CreateMeshFromOBJ.
+ */
+struct MeshLoadOptions {
+    // worker threads used to parse OBJ files; 0 means one per hardware thread
+    unsigned int parseThreads = 0;
+    // read and write "<model>.meshcache" blobs so repeat launches skip OBJ parsing
+    bool useCache = true;
+    // reorder triangles for the post-transform cache and vertices for fetch locality
+    bool optimizeVertexCache = true;
+    // reorder cache-optimised triangles to cut overdraw, allowing this much ACMR growth
+    // (1.05 = 5%); 0 disables the stage. Needs optimizeVertexCache.
+    float overdrawThreshold = 1.05f;
+    // upload quantised VertexCompact vertices and 16-bit indices when they fit
+    bool compactVertices = false;
+    // split the uploaded index buffer into meshlets so RenderMeshlets can cull clusters
+    bool buildMeshlets = true;
+    // simplified levels appended after the full mesh, each as a fraction of its triangles
+    // and the largest error allowed relative to the mesh extent; empty disables LODs
+    std::vector<LodTarget> lodTargets = {{0.5f, 0.01f}, {0.25f, 0.02f}, {0.1f, 0.05f}};
+    // occluder meshes use the coarsest LOD within this error relative to the mesh extent
+    float occluderMaxError = 0.0f;
 };
 
 class Mesh
@@ -27,14 +56,93 @@ class Mesh
         ~Mesh();
 
         void CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
-        void RenderMesh();
+        template <typename Vertex, typename Index>
+        void CreateMesh(const Vertex* vertices, const Index* indices, size_t numOfVertices, size_t numOfIndices);
+        void RenderMesh(unsigned int lod = 0);
+        // draw the instances visible after instances.Cull in one call
+        void RenderInstanced(unsigned int lod, const InstanceBuffer &instances);
+        // draw with the DrawElementsIndirectCommand at this offset in the bound GL_DRAW_INDIRECT_BUFFER (GL 4.0+);
+        // its firstIndex and baseVertex must come from GetDrawRange
+        void RenderIndirect(const void *command);
+        // draw only the meshlets inside the frustum and, with coneCulling, facing the camera
+        void RenderMeshlets(const glm::mat4 &model, const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition,
+                            bool coneCulling, MeshletCullStats &stats);
         void ClearMesh();
-        bool CreateMeshFromOBJ(const char * path);
+        // keepOccluder keeps a CPU copy of the geometry for OcclusionCuller
+        bool CreateMeshFromOBJ(const char * path, bool keepOccluder = false);
         void CreateMeshWithTexture(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
 
+        static void SetLoadOptions(const MeshLoadOptions &options) {loadOptions = options;}
+
+        // dequantisation for the vertex shader: position = aPos * scale + offset
+        glm::vec3 GetPositionScale() const {return positionScale;}
+        glm::vec3 GetPositionOffset() const {return positionOffset;}
+        bool HasOctahedralNormals() const {return octahedralNormals;}
+        bool HasMeshlets() const {return !meshlets.empty();}
+        // level 0 is the full mesh; higher levels are progressively simplified
+        unsigned int GetLodCount() const {return static_cast<unsigned int>(lods.size());}
+        const MeshLod &GetLod(unsigned int lod) const {return lods[lod];}
+        // where a LOD lives in the mesh's GeometryHeap
+        DrawRange GetDrawRange(unsigned int lod) const {
+            return GeometryHeap::GetDrawRange(allocation, lods[lod].indexOffset, lods[lod].indexCount);
+        }
+        // model-space bounding box and sphere; TransformBounds places them in the world
+        const Bounds &GetBounds() const {return bounds;}
+        GeometryHeap *GetHeap() const {return heap;}
+        GLenum GetIndexType() const {return allocation.indexType;}
+        // bytes the mesh takes in its heap's vertex and index buffers
+        size_t GetGpuBytes() const {
+            return heap == nullptr ? 0 : size_t(allocation.vertexCount) * heap->GetStride() +
+                                         size_t(allocation.indexCount) * allocation.GetIndexSize();
+        }
+        bool IsOccluder() const {return !occluder.indices.empty();}
+        const OccluderMesh &GetOccluder() const {return occluder;}
+
     private:
-        GLuint VAO, VBO, IBO, vertexBuffer, uvBuffer, normalBuffer;
+        // shared with every other mesh of the same vertex format
+        GeometryHeap *heap;
+        GeometryAllocation allocation;
         GLsizei indexCount;
+        std::vector<MeshLod> lods;
+        Bounds bounds;
+        glm::vec3 positionScale, positionOffset;
+        bool octahedralNormals;
+        std::vector<Meshlet> meshlets;
+        // scratch for glMultiDrawElements, reused across frames
+        std::vector<GLsizei> drawCounts;
+        std::vector<const void *> drawOffsets;
+        std::vector<GLint> drawBaseVertices;
+        OccluderMesh occluder;
+        bool buildOccluder;
+
+        void UploadMesh(const MeshView &mesh);
+        // replace the single full-range LOD that CreateMesh sets up with the mesh's LOD chain
+        void SetLods(const MeshView &mesh);
+
+        static MeshLoadOptions loadOptions;
+
+        static uint64_t GetProcessingFlags();
 };
 
+/**
+ * Copy interleaved vertices and indices into the GeometryHeap for Vertex's VertexLayout.
+ */
+template <typename Vertex, typename Index>
+void Mesh::CreateMesh(const Vertex* vertices, const Index* indices, size_t numOfVertices, size_t numOfIndices) {
+    if (heap != nullptr) {
+        heap->Free(allocation);
+    }
+    heap = &GeometryHeap::Get<Vertex>();
+    allocation = heap->Allocate(vertices, numOfVertices, indices, numOfIndices, IndexTraits<Index>::type);
+    if (!allocation.IsValid()) {
+        std::cerr << "Error: no room for " << numOfVertices << " vertices and " << numOfIndices
+                  << " indices in the geometry heap" << std::endl;
+        indexCount = 0;
+        lods.clear();
+        return;
+    }
+    indexCount = numOfIndices;
+    lods.assign(1, MeshLod{0, static_cast<unsigned int>(numOfIndices), 0.0f});
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+const char kMagic[8] = {'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H'};
+const uint64_t kAlignment = 16;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t lodCount;
+    uint64_t flags;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphereCenter[3];
+    float sphereRadius;
+    uint64_t vertexStride;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t lodsOffset;
+    uint64_t totalSize;
+};
+
+uint64_t AlignUp(uint64_t value) {
+    return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+/**
+ * 64-bit hash that consumes eight bytes per step, so validating a source file costs
+ * a small fraction of parsing it.
+ */
+uint64_t HashBytes(const char *data, size_t size) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h ^= word * 0xFF51AFD7ED558CCDull;
+        h = ((h << 31) | (h >> 33)) * 0xC4CEB9FE1A85EC53ull;
+    }
+    for (; i < size; i++) {
+        h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+    }
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+std::string MeshCache::GetCachePath(const char *sourcePath) {
+    return std::string(sourcePath) + ".meshcache";
+}
+
+bool MeshCache::ComputeSourceKey(const char *sourcePath, MeshSourceKey &key) {
+    std::error_code error;
+    auto mtime = std::filesystem::last_write_time(sourcePath, error);
+    if (error) {
+        return false;
+    }
+
+    MappedFile source;
+    if (!source.Open(sourcePath)) {
+        return false;
+    }
+    key.size = source.GetSize();
+    key.mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+    key.hash = HashBytes(source.GetData(), source.GetSize());
+    return true;
+}
+
+bool MeshCache::Write(const char *cachePath, const MeshSourceKey &key, uint64_t flags, const MeshData &mesh) {
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = VERSION;
+    header.flags = flags;
+    header.sourceSize = key.size;
+    header.sourceMtime = key.mtime;
+    header.sourceHash = key.hash;
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = mesh.bounds.boxMin[i];
+        header.boundsMax[i] = mesh.bounds.boxMax[i];
+        header.sphereCenter[i] = mesh.bounds.sphereCenter[i];
+    }
+    header.sphereRadius = mesh.bounds.sphereRadius;
+    header.vertexStride = sizeof(VertexPTN);
+    header.verticesOffset = AlignUp(sizeof(MeshCacheHeader));
+    header.indicesOffset = AlignUp(header.verticesOffset + header.vertexCount * sizeof(VertexPTN));
+    header.lodsOffset = AlignUp(header.indicesOffset + header.indexCount * sizeof(unsigned int));
+    header.totalSize = header.lodsOffset + header.lodCount * sizeof(MeshLod);
+
+    std::string tempPath = std::string(cachePath) + ".tmp";
+    FILE *out = fopen(tempPath.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+
+    struct Section {
+        uint64_t offset;
+        const void *data;
+        size_t bytes;
+    };
+    const Section sections[] = {
+        {0, &header, sizeof(header)},
+        {header.verticesOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(VertexPTN)},
+        {header.indicesOffset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)},
+        {header.lodsOffset, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod)},
+    };
+
+    static const char padding[kAlignment] = {0};
+    uint64_t written = 0;
+    bool ok = true;
+    for (const Section &section : sections) {
+        ok = ok && fwrite(padding, 1, section.offset - written, out) == section.offset - written;
+        ok = ok && (section.bytes == 0 || fwrite(section.data, 1, section.bytes, out) == section.bytes);
+        written = section.offset + section.bytes;
+    }
+    ok = fclose(out) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(tempPath, cachePath, error);
+    }
+    if (!ok || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::Open(const char *cachePath, const MeshSourceKey &key, uint64_t flags) {
+    view = MeshView();
+    if (!file.Open(cachePath)) {
+        return false;
+    }
+
+    const char *data = file.GetData();
+    MeshCacheHeader header;
+    if (file.GetSize() < sizeof(header)) {
+        file.Close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    bool valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == VERSION &&
+                 header.flags == flags &&
+                 header.sourceSize == key.size &&
+                 header.sourceMtime == key.mtime &&
+                 header.sourceHash == key.hash &&
+                 header.totalSize == file.GetSize() &&
+                 header.vertexStride == sizeof(VertexPTN) &&
+                 header.verticesOffset % kAlignment == 0 &&
+                 header.indicesOffset % kAlignment == 0 &&
+                 header.lodsOffset % kAlignment == 0 &&
+                 header.lodsOffset + header.lodCount * sizeof(MeshLod) <= header.totalSize &&
+                 header.indicesOffset + header.indexCount * sizeof(unsigned int) <= header.lodsOffset &&
+                 header.verticesOffset + header.vertexCount * sizeof(VertexPTN) <= header.indicesOffset;
+    if (!valid) {
+        file.Close();
+        return false;
+    }
+
+    view.vertices = reinterpret_cast<const VertexPTN *>(data + header.verticesOffset);
+    view.indices = reinterpret_cast<const unsigned int *>(data + header.indicesOffset);
+    view.vertexCount = header.vertexCount;
+    view.indexCount = header.indexCount;
+    view.lods = reinterpret_cast<const MeshLod *>(data + header.lodsOffset);
+    view.lodCount = header.lodCount;
+    for (size_t i = 0; i < view.lodCount; i++) {
+        if (uint64_t(view.lods[i].indexOffset) + view.lods[i].indexCount > view.indexCount) {
+            file.Close();
+            view = MeshView();
+            return false;
+        }
+    }
+    view.bounds.boxMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    view.bounds.boxMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    view.bounds.sphereCenter = glm::vec3(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2]);
+    view.bounds.sphereRadius = header.sphereRadius;
+    return true;
+}
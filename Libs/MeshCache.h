@@ -0,0 +1,58 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+
+/**
+ * Identity of a mesh source file. A cache blob is only reused when all three match.
+ */
+struct MeshSourceKey {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+};
+
+/**
+ * Versioned binary cache of a processed mesh, stored next to its source as
+ * "<source>.meshcache". The blob holds the deduplicated interleaved vertices, the index
+ * buffer with every LOD's range, and the bounding box and sphere; opening it memory-maps the file and exposes views into
+ * the mapping, so the arrays can go straight to glBufferData without a copy.
+ */
+class MeshCache {
+public:
+    // bump whenever the blob layout or the processing that produced it changes
+    static const uint32_t VERSION = 4;
+
+    static std::string GetCachePath(const char *sourcePath);
+
+    /**
+     * Stat and hash a source file.
+     * @return false if the file could not be read.
+     */
+    static bool ComputeSourceKey(const char *sourcePath, MeshSourceKey &key);
+
+    /**
+     * Write a cache blob. The file is written under a temporary name and renamed,
+     * so a crash never leaves a truncated blob behind.
+     * @param flags Processing options that produced the mesh; part of the cache key.
+     */
+    static bool Write(const char *cachePath, const MeshSourceKey &key, uint64_t flags, const MeshData &mesh);
+
+    /**
+     * Map a cache blob and validate it against the source key, version and flags.
+     * @return false if the blob is missing, stale or malformed.
+     */
+    bool Open(const char *cachePath, const MeshSourceKey &key, uint64_t flags);
+
+    const MeshView &GetView() const { return view; }
+
+private:
+    MappedFile file;
+    MeshView view;
+};
+
+#endif //MESHCACHE_H
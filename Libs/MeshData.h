@@ -0,0 +1,119 @@
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+/**
+ * Position + texture coordinate vertex, as used by Mesh::CreateMesh.
+ */
+struct VertexPT {
+    glm::vec3 position;
+    glm::vec2 texCoord;
+};
+
+/**
+ * Position + texture coordinate + normal vertex, the interleaved format of loaded models.
+ */
+struct VertexPTN {
+    glm::vec3 position;
+    glm::vec2 texCoord;
+    glm::vec3 normal;
+};
+
+/**
+ * Four normalised unsigned 16-bit components.
+ */
+struct Unorm16x4 {
+    uint16_t x, y, z, w;
+};
+
+/**
+ * Two signed 16-bit components, read as normalised [-1, 1].
+ */
+struct Snorm16x2 {
+    int16_t x, y;
+};
+
+/**
+ * Two IEEE half-precision floats.
+ */
+struct Half2 {
+    uint16_t x, y;
+};
+
+/**
+ * Compact 16-byte vertex: position quantised to unorm16 against the mesh bounds,
+ * half-float texture coordinate and an octahedral-encoded snorm16 normal.
+ */
+struct VertexCompact {
+    Unorm16x4 position;
+    Half2 texCoord;
+    Snorm16x2 normal;
+};
+
+/**
+ * Index range of one level of detail. All levels share the vertex buffer.
+ */
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    // simplification error relative to the mesh extent, 0 for the full mesh
+    float error;
+};
+
+/**
+ * Deduplicated, indexed geometry ready for upload: one interleaved vertex per
+ * unique (position, texture coordinate, normal) corner.
+ */
+struct MeshData {
+    std::vector<VertexPTN> vertices;
+    // every LOD's indices back to back; without LODs the whole buffer is the full mesh
+    std::vector<unsigned int> indices;
+    std::vector<MeshLod> lods;
+    Bounds bounds;
+};
+
+/**
+ * Non-owning view of indexed geometry. It can point into a MeshData or straight
+ * into a memory-mapped mesh cache blob; both are uploaded the same way.
+ */
+struct MeshView {
+    const VertexPTN *vertices = nullptr;
+    const unsigned int *indices = nullptr;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    const MeshLod *lods = nullptr;
+    size_t lodCount = 0;
+    Bounds bounds;
+
+    // number of indices of the full-detail mesh
+    size_t GetFullIndexCount() const { return lodCount > 0 ? lods[0].indexCount : indexCount; }
+};
+
+inline MeshView MakeMeshView(const MeshData &mesh) {
+    MeshView view;
+    view.vertices = mesh.vertices.data();
+    view.indices = mesh.indices.data();
+    view.vertexCount = mesh.vertices.size();
+    view.indexCount = mesh.indices.size();
+    view.lods = mesh.lods.data();
+    view.lodCount = mesh.lods.size();
+    view.bounds = mesh.bounds;
+    return view;
+}
+
+/**
+ * Recompute the bounding box and sphere of a mesh from its positions.
+ */
+inline void ComputeMeshBounds(MeshData &mesh) {
+    mesh.bounds = ComputeBounds(mesh.vertices.empty() ? nullptr : &mesh.vertices[0].position,
+                                mesh.vertices.size(), sizeof(VertexPTN));
+}
+
+#endif //MESHDATA_H
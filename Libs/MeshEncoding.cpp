@@ -0,0 +1,66 @@
+#include "MeshEncoding.h"
+
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+namespace {
+
+uint16_t QuantiseUnorm16(float value) {
+    value = glm::clamp(value, 0.0f, 1.0f);
+    return static_cast<uint16_t>(std::lround(value * 65535.0f));
+}
+
+int16_t QuantiseSnorm16(float value) {
+    value = glm::clamp(value, -1.0f, 1.0f);
+    return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+}
+
+glm::vec2 OctahedralEncode(const glm::vec3 &normal) {
+    float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (sum == 0.0f) {
+        // OBJ corners without a normal
+        return glm::vec2(0.0f);
+    }
+    glm::vec2 p(normal.x / sum, normal.y / sum);
+    if (normal.z < 0.0f) {
+        // fold the lower hemisphere over the diagonals
+        glm::vec2 folded((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        p = folded;
+    }
+    return p;
+}
+
+void EncodeCompactMesh(const MeshView &mesh, CompactMesh &out) {
+    glm::vec3 extent = mesh.bounds.GetBoxExtent();
+    out.positionOffset = mesh.bounds.boxMin;
+    out.positionScale = extent;
+
+    out.vertices.resize(mesh.vertexCount);
+    for (size_t v = 0; v < mesh.vertexCount; v++) {
+        const VertexPTN &source = mesh.vertices[v];
+        VertexCompact &vertex = out.vertices[v];
+
+        glm::vec3 unit(0.0f);
+        for (int axis = 0; axis < 3; axis++) {
+            unit[axis] = extent[axis] > 0.0f ? (source.position[axis] - mesh.bounds.boxMin[axis]) / extent[axis] : 0.0f;
+        }
+        vertex.position = Unorm16x4{QuantiseUnorm16(unit.x), QuantiseUnorm16(unit.y), QuantiseUnorm16(unit.z), 0};
+        vertex.texCoord = Half2{glm::packHalf1x16(source.texCoord.x), glm::packHalf1x16(source.texCoord.y)};
+
+        glm::vec2 octahedral = OctahedralEncode(source.normal);
+        vertex.normal = Snorm16x2{QuantiseSnorm16(octahedral.x), QuantiseSnorm16(octahedral.y)};
+    }
+
+    out.shortIndices = mesh.vertexCount <= 65536;
+    out.indices16.clear();
+    if (out.shortIndices) {
+        out.indices16.resize(mesh.indexCount);
+        for (size_t i = 0; i < mesh.indexCount; i++) {
+            out.indices16[i] = static_cast<uint16_t>(mesh.indices[i]);
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef MESHENCODING_H
+#define MESHENCODING_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+/**
+ * A mesh re-encoded into VertexCompact, with 16-bit indices when every index fits.
+ * Positions decode in the vertex shader as position * positionScale + positionOffset.
+ */
+struct CompactMesh {
+    std::vector<VertexCompact> vertices;
+    std::vector<uint16_t> indices16;
+    bool shortIndices = false;
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+};
+
+/**
+ * Map a unit vector onto the octahedron and unfold it into [-1, 1]^2.
+ */
+glm::vec2 OctahedralEncode(const glm::vec3 &normal);
+
+/**
+ * Quantise a mesh into the compact vertex format.
+ * @param mesh Full-precision mesh; its bounds are used to quantise positions.
+ * @param out Receives the compact vertices, indices and dequantisation constants.
+ */
+void EncodeCompactMesh(const MeshView &mesh, CompactMesh &out);
+
+#endif //MESHENCODING_H
@@ -0,0 +1,433 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Forsyth's tuning constants
+const int kCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+const unsigned int kValenceTableSize = 64;
+
+struct ScoreTables {
+    float cache[kCacheSize];
+    float valence[kValenceTableSize];
+
+    ScoreTables() {
+        for (int i = 0; i < kCacheSize; i++) {
+            if (i < 3) {
+                // the last triangle's vertices get a fixed score so the next pick is not biased towards them
+                cache[i] = kLastTriangleScore;
+            } else {
+                float scaler = 1.0f - float(i - 3) / float(kCacheSize - 3);
+                cache[i] = std::pow(scaler, kCacheDecayPower);
+            }
+        }
+        valence[0] = 0.0f;
+        for (unsigned int i = 1; i < kValenceTableSize; i++) {
+            valence[i] = kValenceBoostScale * std::pow(float(i), -kValenceBoostPower);
+        }
+    }
+};
+
+const ScoreTables &GetScoreTables() {
+    static const ScoreTables tables;
+    return tables;
+}
+
+float VertexScore(const ScoreTables &tables, int cachePosition, unsigned int remaining) {
+    if (remaining == 0) {
+        // no triangle needs this vertex any more
+        return -1.0f;
+    }
+    float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+    score += remaining < kValenceTableSize
+             ? tables.valence[remaining]
+             : kValenceBoostScale * std::pow(float(remaining), -kValenceBoostPower);
+    return score;
+}
+
+// FIFO cache used to place overdraw cluster boundaries
+const unsigned int kOverdrawCacheSize = 16;
+// resolution of each view when measuring overdraw
+const int kOverdrawViewSize = 256;
+
+/**
+ * FIFO post-transform cache simulation that can be reset between clusters.
+ */
+class FifoCache {
+public:
+    FifoCache(size_t vertexCount, unsigned int cacheSize) : insertedAt(vertexCount, 0), size(cacheSize) {
+        Reset();
+    }
+
+    void Reset() {
+        // jump far enough ahead that every vertex looks evicted
+        clock += size + 1;
+    }
+
+    unsigned int AddTriangle(const unsigned int *triangle) {
+        unsigned int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            if (clock - insertedAt[triangle[k]] > size) {
+                insertedAt[triangle[k]] = clock++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+private:
+    std::vector<unsigned int> insertedAt;
+    unsigned int size;
+    unsigned int clock = 0;
+};
+
+/**
+ * Rasterise triangles projected onto one axis plane into a depth buffer,
+ * counting fragments that pass the depth test.
+ */
+void RasteriseView(const std::vector<VertexPTN> &vertices, const std::vector<unsigned int> &indices,
+                   int axisU, int axisV, int axisDepth, bool flipDepth, const glm::vec3 &boundsMin,
+                   const glm::vec3 &extent, std::vector<float> &depth, OverdrawStats &stats) {
+    const int size = kOverdrawViewSize;
+    std::fill(depth.begin(), depth.end(), 2.0f);
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 screen[3];
+        for (int k = 0; k < 3; k++) {
+            glm::vec3 p = (vertices[indices[t + k]].position - boundsMin) / extent;
+            float d = flipDepth ? 1.0f - p[axisDepth] : p[axisDepth];
+            screen[k] = glm::vec3(p[axisU] * size, p[axisV] * size, d);
+        }
+
+        float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                     (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+        if (area == 0.0f) {
+            continue;
+        }
+
+        int minX = std::max(0, int(std::floor(std::min({screen[0].x, screen[1].x, screen[2].x}))));
+        int maxX = std::min(size - 1, int(std::ceil(std::max({screen[0].x, screen[1].x, screen[2].x}))));
+        int minY = std::max(0, int(std::floor(std::min({screen[0].y, screen[1].y, screen[2].y}))));
+        int maxY = std::min(size - 1, int(std::ceil(std::max({screen[0].y, screen[1].y, screen[2].y}))));
+
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x++) {
+                float px = x + 0.5f, py = y + 0.5f;
+                float w0 = (screen[2].x - screen[1].x) * (py - screen[1].y) - (screen[2].y - screen[1].y) * (px - screen[1].x);
+                float w1 = (screen[0].x - screen[2].x) * (py - screen[2].y) - (screen[0].y - screen[2].y) * (px - screen[2].x);
+                float w2 = (screen[1].x - screen[0].x) * (py - screen[0].y) - (screen[1].y - screen[0].y) * (px - screen[0].x);
+                // accept both windings: back faces are not culled by the renderer
+                bool inside = area > 0.0f ? (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+                                          : (w0 <= 0.0f && w1 <= 0.0f && w2 <= 0.0f);
+                if (!inside) {
+                    continue;
+                }
+                float z = (w0 * screen[0].z + w1 * screen[1].z + w2 * screen[2].z) / area;
+                float &stored = depth[y * size + x];
+                if (z < stored) {
+                    if (stored > 1.5f) {
+                        stats.pixelsCovered++;
+                    }
+                    stored = z;
+                    stats.pixelsShaded++;
+                }
+            }
+        }
+    }
+}
+
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                    unsigned int cacheSize) {
+    VertexCacheStats stats;
+    if (indices.empty()) {
+        return stats;
+    }
+
+    // timestamps make the FIFO test O(1): a vertex is cached if it was inserted
+    // fewer than cacheSize insertions ago
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int clock = cacheSize + 1;
+    unsigned int uniqueVertices = 0;
+
+    for (unsigned int index : indices) {
+        if (clock - insertedAt[index] > cacheSize) {
+            insertedAt[index] = clock++;
+            stats.vertexTransforms++;
+        }
+        if (!referenced[index]) {
+            referenced[index] = true;
+            uniqueVertices++;
+        }
+    }
+
+    stats.acmr = float(stats.vertexTransforms) / float(indices.size() / 3);
+    stats.atvr = float(stats.vertexTransforms) / float(uniqueVertices);
+    return stats;
+}
+
+void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    const ScoreTables &tables = GetScoreTables();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangle adjacency per vertex, stored compactly; the live prefix of each
+    // vertex's range holds the triangles that have not been emitted yet
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices) {
+        remaining[index]++;
+    }
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScore[v] = VertexScore(tables, -1, remaining[v]);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                           vertexScore[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best]) {
+            best = t;
+        }
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    unsigned int cache[kCacheSize + 3];
+    unsigned int nextCache[kCacheSize + 3];
+    int cacheCount = 0;
+    size_t scanCursor = 0;
+    bool haveBest = true;
+
+    while (output.size() < indices.size()) {
+        if (!haveBest) {
+            // nothing in the cache touches a pending triangle: restart from the next one in file order
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            best = scanCursor;
+        }
+
+        const unsigned int *triangle = &indices[best * 3];
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // retire the triangle from its vertices' adjacency lists
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = triangle[k];
+            unsigned int *begin = &adjacency[offsets[v]];
+            unsigned int *end = begin + remaining[v];
+            unsigned int *found = std::find(begin, end, static_cast<unsigned int>(best));
+            std::swap(*found, *(end - 1));
+            remaining[v]--;
+        }
+
+        // move the triangle's vertices to the front of the LRU cache
+        int nextCount = 0;
+        for (int k = 0; k < 3; k++) {
+            nextCache[nextCount++] = triangle[k];
+        }
+        for (int i = 0; i < cacheCount; i++) {
+            unsigned int v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache[nextCount++] = v;
+            }
+        }
+
+        for (int i = 0; i < nextCount; i++) {
+            unsigned int v = nextCache[i];
+            cachePosition[v] = i < kCacheSize ? i : -1;
+            vertexScore[v] = VertexScore(tables, cachePosition[v], remaining[v]);
+        }
+
+        // rescore the pending triangles around the cache and pick the best one
+        haveBest = false;
+        float bestScore = -1.0f;
+        for (int i = 0; i < nextCount; i++) {
+            unsigned int v = nextCache[i];
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++) {
+                unsigned int t = adjacency[a];
+                float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                              vertexScore[indices[t * 3 + 2]];
+                triangleScore[t] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                    haveBest = true;
+                }
+            }
+        }
+
+        cacheCount = std::min(nextCount, kCacheSize);
+        std::copy(nextCache, nextCache + cacheCount, cache);
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(MeshData &mesh) {
+    const unsigned int unassigned = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(mesh.vertices.size(), unassigned);
+    unsigned int next = 0;
+    for (unsigned int &index : mesh.indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    std::vector<VertexPTN> vertices(next);
+    for (size_t v = 0; v < remap.size(); v++) {
+        if (remap[v] != unassigned) {
+            vertices[remap[v]] = mesh.vertices[v];
+        }
+    }
+    mesh.vertices.swap(vertices);
+}
+
+OverdrawStats AnalyzeOverdraw(const std::vector<VertexPTN> &vertices, const std::vector<unsigned int> &indices) {
+    OverdrawStats stats;
+    if (vertices.empty() || indices.empty()) {
+        return stats;
+    }
+
+    glm::vec3 boundsMin = vertices[0].position, boundsMax = vertices[0].position;
+    for (const VertexPTN &vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    // a uniform scale keeps the aspect ratio of every view
+    float largest = std::max({boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z, 1e-6f});
+    glm::vec3 extent(largest);
+
+    std::vector<float> depth(kOverdrawViewSize * kOverdrawViewSize);
+    for (int axis = 0; axis < 3; axis++) {
+        for (int flip = 0; flip < 2; flip++) {
+            RasteriseView(vertices, indices, (axis + 1) % 3, (axis + 2) % 3, axis, flip == 1,
+                          boundsMin, extent, depth, stats);
+        }
+    }
+
+    stats.overdraw = stats.pixelsCovered ? float(stats.pixelsShaded) / float(stats.pixelsCovered) : 0.0f;
+    return stats;
+}
+
+void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<VertexPTN> &vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // hard boundaries: triangles that miss the cache on all three vertices start a new run
+    std::vector<size_t> hardBoundaries;
+    FifoCache cache(vertices.size(), kOverdrawCacheSize);
+    for (size_t t = 0; t < triangleCount; t++) {
+        if (cache.AddTriangle(&indices[t * 3]) == 3 || t == 0) {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // soft boundaries: split runs wherever the cluster so far is within threshold of the run's ACMR
+    std::vector<size_t> clusterStarts;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++) {
+        size_t start = hardBoundaries[h], end = hardBoundaries[h + 1];
+
+        cache.Reset();
+        unsigned int runMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            runMisses += cache.AddTriangle(&indices[t * 3]);
+        }
+        float clusterThreshold = threshold * float(runMisses) / float(end - start);
+
+        cache.Reset();
+        clusterStarts.push_back(start);
+        unsigned int misses = 0, triangles = 0;
+        for (size_t t = start; t < end; t++) {
+            misses += cache.AddTriangle(&indices[t * 3]);
+            triangles++;
+            if (t + 1 < end && float(misses) / float(triangles) <= clusterThreshold) {
+                clusterStarts.push_back(t + 1);
+                cache.Reset();
+                misses = triangles = 0;
+            }
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+
+    // area-weighted mesh centroid
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const glm::vec3 &a = vertices[indices[t * 3]].position;
+        const glm::vec3 &b = vertices[indices[t * 3 + 1]].position;
+        const glm::vec3 &c = vertices[indices[t * 3 + 2]].position;
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCentroid += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : vertices[indices[0]].position;
+
+    // clusters far out along their own normal are likely occluders from most viewpoints
+    std::vector<float> sortKey(clusterCount);
+    for (size_t i = 0; i < clusterCount; i++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float clusterArea = 0.0f;
+        for (size_t t = clusterStarts[i]; t < clusterStarts[i + 1]; t++) {
+            const glm::vec3 &a = vertices[indices[t * 3]].position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 &c = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 cross = glm::cross(b - a, c - a);
+            float area = glm::length(cross);
+            centroid += (a + b + c) * (area / 3.0f);
+            normal += cross;
+            clusterArea += area;
+        }
+        if (clusterArea > 0.0f) {
+            centroid /= clusterArea;
+        }
+        float normalLength = glm::length(normal);
+        sortKey[i] = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t i = 0; i < clusterCount; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b) {
+        return sortKey[a] > sortKey[b];
+    });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (size_t i : order) {
+        output.insert(output.end(), indices.begin() + clusterStarts[i] * 3, indices.begin() + clusterStarts[i + 1] * 3);
+    }
+    indices.swap(output);
+}
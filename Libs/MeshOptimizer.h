@@ -0,0 +1,72 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "MeshData.h"
+
+/**
+ * Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache.
+ * ACMR is transformed vertices per triangle (0.5 is ideal for large grids, 3 is worst);
+ * ATVR is transformed vertices per unique vertex (1 is ideal).
+ */
+struct VertexCacheStats {
+    unsigned int vertexTransforms = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+/**
+ * Pixel shading cost of drawing a mesh, measured by rasterising it with a depth test
+ * from the six axis directions. Overdraw is shaded fragments per covered pixel (1 is ideal).
+ */
+struct OverdrawStats {
+    unsigned int pixelsCovered = 0;
+    unsigned int pixelsShaded = 0;
+    float overdraw = 0.0f;
+};
+
+/**
+ * Simulate a FIFO post-transform cache over an index buffer.
+ * @param indices Triangle list indices.
+ * @param vertexCount Number of vertices the indices refer to.
+ * @param cacheSize Number of entries in the simulated cache.
+ */
+VertexCacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                    unsigned int cacheSize = 16);
+
+/**
+ * Reorder triangles for post-transform cache locality using Forsyth's
+ * linear-speed algorithm. Vertex data is untouched.
+ * @param indices Triangle list indices, reordered in place.
+ * @param vertexCount Number of vertices the indices refer to.
+ */
+void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+/**
+ * Measure overdraw by rasterising the mesh in submission order at low resolution
+ * from the six axis directions. Back faces are not culled, matching the renderer.
+ * @param vertices Mesh vertices.
+ * @param indices Triangle list indices in submission order.
+ */
+OverdrawStats AnalyzeOverdraw(const std::vector<VertexPTN> &vertices, const std::vector<unsigned int> &indices);
+
+/**
+ * Reorder a cache-optimised index buffer to reduce overdraw. Triangles are split into
+ * clusters at cache-friendly boundaries, and clusters that face away from the mesh centre
+ * are drawn first so they occlude the inner ones. Run OptimizeVertexCache first.
+ * @param indices Triangle list indices, reordered in place.
+ * @param vertices Mesh vertices.
+ * @param threshold Largest allowed ACMR growth per cluster, e.g. 1.05 for 5%.
+ */
+void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<VertexPTN> &vertices, float threshold);
+
+/**
+ * Reorder vertices into first-use order of the index buffer so vertex fetches
+ * walk memory linearly. Vertices no triangle refers to are dropped.
+ * @param mesh The mesh whose vertex arrays and indices are rewritten.
+ */
+void OptimizeVertexFetch(MeshData &mesh);
+
+#endif //MESHOPTIMIZER_H
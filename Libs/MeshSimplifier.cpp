@@ -0,0 +1,523 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const unsigned int kNone = 0xFFFFFFFFu;
+
+// weight of the planes that keep open borders and UV seams in place
+const double kBorderWeight = 10.0;
+const double kSeamWeight = 1.0;
+// collapses that turn a triangle's normal further than ~75 degrees are rejected
+const float kFlipThreshold = 0.25f;
+
+enum VertexKind : unsigned char {
+    // interior vertex with a single set of attributes; may collapse anywhere
+    KIND_MANIFOLD,
+    // on an open edge; may only slide along it
+    KIND_BORDER,
+    // two attribute sets split by a UV seam; both slide along the seam together
+    KIND_SEAM,
+    // anything more complicated; never moves
+    KIND_LOCKED,
+};
+
+// whether a vertex of the row's kind may collapse onto a vertex of the column's kind
+const bool kCanCollapse[4][4] = {
+    {true, true, true, true},
+    {false, true, false, true},
+    {false, false, true, false},
+    {false, false, false, false},
+};
+
+/**
+ * Symmetric 4x4 error quadric with its accumulated weight; Evaluate gives the
+ * weighted mean squared distance of a point to the planes folded into it.
+ */
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0, w = 0;
+
+    void AddPlane(const glm::vec3 &normal, double distance, double weight) {
+        double nx = normal.x, ny = normal.y, nz = normal.z;
+        a00 += weight * nx * nx;
+        a11 += weight * ny * ny;
+        a22 += weight * nz * nz;
+        a01 += weight * nx * ny;
+        a02 += weight * nx * nz;
+        a12 += weight * ny * nz;
+        b0 += weight * nx * distance;
+        b1 += weight * ny * distance;
+        b2 += weight * nz * distance;
+        c += weight * distance * distance;
+        w += weight;
+    }
+
+    void Add(const Quadric &other) {
+        a00 += other.a00;
+        a11 += other.a11;
+        a22 += other.a22;
+        a01 += other.a01;
+        a02 += other.a02;
+        a12 += other.a12;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        w += other.w;
+    }
+
+    double Evaluate(const glm::vec3 &p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double error = a00 * x * x + a11 * y * y + a22 * z * z +
+                       2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                       2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return w > 0.0 ? std::max(error, 0.0) / w : 0.0;
+    }
+};
+
+struct Collapse {
+    unsigned int v0, v1;
+    double cost;
+};
+
+/**
+ * Compressed adjacency: the items of key k are items[offsets[k]..offsets[k + 1]).
+ */
+struct Adjacency {
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> items;
+
+    const unsigned int *begin(unsigned int key) const { return items.data() + offsets[key]; }
+    const unsigned int *end(unsigned int key) const { return items.data() + offsets[key + 1]; }
+};
+
+/**
+ * Link vertices that share a position: remap points at the lowest-numbered vertex with
+ * the same position and wedge cycles through all of them. Sorting instead of hashing
+ * keeps the result independent of the standard library.
+ */
+void BuildPositionRemap(const std::vector<VertexPTN> &vertices, std::vector<unsigned int> &remap,
+                        std::vector<unsigned int> &wedge) {
+    size_t vertexCount = vertices.size();
+    std::vector<unsigned int> order(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        order[i] = static_cast<unsigned int>(i);
+    }
+    auto less = [&vertices](unsigned int a, unsigned int b) {
+        int compare = memcmp(&vertices[a].position, &vertices[b].position, sizeof(glm::vec3));
+        return compare != 0 ? compare < 0 : a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    remap.resize(vertexCount);
+    wedge.resize(vertexCount);
+    for (size_t start = 0; start < vertexCount;) {
+        size_t end = start + 1;
+        while (end < vertexCount &&
+               memcmp(&vertices[order[start]].position, &vertices[order[end]].position, sizeof(glm::vec3)) == 0) {
+            end++;
+        }
+        // order is ascending within a group, so order[start] is the lowest index
+        for (size_t i = start; i < end; i++) {
+            remap[order[i]] = order[start];
+            wedge[order[i]] = order[i + 1 < end ? i + 1 : start];
+        }
+        start = end;
+    }
+}
+
+/**
+ * Outgoing half-edges per vertex, i.e. for every triangle corner a the next corner b.
+ */
+Adjacency BuildHalfEdges(const std::vector<unsigned int> &indices, size_t vertexCount) {
+    Adjacency edges;
+    edges.offsets.assign(vertexCount + 1, 0);
+    for (unsigned int v : indices) {
+        edges.offsets[v + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        edges.offsets[v + 1] += edges.offsets[v];
+    }
+    edges.items.resize(indices.size());
+    std::vector<unsigned int> fill(edges.offsets.begin(), edges.offsets.end() - 1);
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+            edges.items[fill[a]++] = b;
+        }
+    }
+    return edges;
+}
+
+bool HasHalfEdge(const Adjacency &edges, unsigned int a, unsigned int b) {
+    return std::find(edges.begin(a), edges.end(a), b) != edges.end(a);
+}
+
+/**
+ * True if any wedge of a has a half-edge to any wedge of b, i.e. the edge exists
+ * geometrically even if the attributes differ.
+ */
+bool HasPositionalHalfEdge(const Adjacency &edges, const std::vector<unsigned int> &remap,
+                           const std::vector<unsigned int> &wedge, unsigned int a, unsigned int b) {
+    unsigned int w = a;
+    do {
+        for (const unsigned int *e = edges.begin(w); e != edges.end(w); e++) {
+            if (remap[*e] == remap[b]) {
+                return true;
+            }
+        }
+        w = wedge[w];
+    } while (w != a);
+    return false;
+}
+
+/**
+ * Follow open half-edges: loop[a] = b for the open edge a -> b and loopback[b] = a.
+ * kNone means no open edge, the vertex itself means more than one.
+ */
+void BuildOpenEdgeLoops(const Adjacency &edges, std::vector<unsigned int> &loop, std::vector<unsigned int> &loopback) {
+    size_t vertexCount = edges.offsets.size() - 1;
+    loop.assign(vertexCount, kNone);
+    loopback.assign(vertexCount, kNone);
+    for (unsigned int a = 0; a < vertexCount; a++) {
+        for (const unsigned int *e = edges.begin(a); e != edges.end(a); e++) {
+            unsigned int b = *e;
+            if (HasHalfEdge(edges, b, a)) {
+                continue;
+            }
+            loop[a] = loop[a] == kNone ? b : a;
+            loopback[b] = loopback[b] == kNone ? a : b;
+        }
+    }
+}
+
+bool IsSingleOpenEdge(unsigned int target, unsigned int v) {
+    return target != kNone && target != v;
+}
+
+std::vector<VertexKind> ClassifyVertices(const std::vector<unsigned int> &remap, const std::vector<unsigned int> &wedge,
+                                         const std::vector<unsigned int> &loop,
+                                         const std::vector<unsigned int> &loopback) {
+    size_t vertexCount = remap.size();
+    std::vector<VertexKind> kinds(vertexCount, KIND_LOCKED);
+    for (unsigned int v = 0; v < vertexCount; v++) {
+        if (remap[v] != v) {
+            continue;
+        }
+        VertexKind kind = KIND_LOCKED;
+        if (wedge[v] == v) {
+            if (loop[v] == kNone && loopback[v] == kNone) {
+                kind = KIND_MANIFOLD;
+            } else if (IsSingleOpenEdge(loop[v], v) && IsSingleOpenEdge(loopback[v], v)) {
+                kind = KIND_BORDER;
+            }
+        } else if (wedge[wedge[v]] == v) {
+            // a seam runs through v if each wedge has one open edge in each direction
+            // and the two wedges' open edges are the same edges traversed oppositely
+            unsigned int w = wedge[v];
+            if (IsSingleOpenEdge(loop[v], v) && IsSingleOpenEdge(loopback[v], v) &&
+                IsSingleOpenEdge(loop[w], w) && IsSingleOpenEdge(loopback[w], w) &&
+                remap[loop[v]] == remap[loopback[w]] && remap[loopback[v]] == remap[loop[w]] &&
+                remap[loop[v]] != remap[loopback[v]]) {
+                kind = KIND_SEAM;
+            }
+        }
+        unsigned int w = v;
+        do {
+            kinds[w] = kind;
+            w = wedge[w];
+        } while (w != v);
+    }
+    return kinds;
+}
+
+glm::vec3 TriangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    return glm::cross(b - a, c - a);
+}
+
+/**
+ * Per-position quadrics: the area-weighted plane of every triangle, plus planes through
+ * open edges perpendicular to their triangle so borders and seams resist moving.
+ */
+std::vector<Quadric> BuildQuadrics(const std::vector<VertexPTN> &vertices, const std::vector<unsigned int> &indices,
+                                   const Adjacency &edges, const std::vector<unsigned int> &remap,
+                                   const std::vector<unsigned int> &wedge) {
+    std::vector<Quadric> quadrics(vertices.size());
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const glm::vec3 &a = vertices[indices[t]].position;
+        const glm::vec3 &b = vertices[indices[t + 1]].position;
+        const glm::vec3 &c = vertices[indices[t + 2]].position;
+        glm::vec3 normal = TriangleNormal(a, b, c);
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            continue;
+        }
+        normal /= length;
+        double distance = -glm::dot(normal, a);
+        for (int k = 0; k < 3; k++) {
+            quadrics[remap[indices[t + k]]].AddPlane(normal, distance, length * 0.5);
+        }
+
+        for (int k = 0; k < 3; k++) {
+            unsigned int i0 = indices[t + k], i1 = indices[t + (k + 1) % 3];
+            if (HasHalfEdge(edges, i1, i0)) {
+                continue;
+            }
+            bool seam = HasPositionalHalfEdge(edges, remap, wedge, i1, i0);
+            const glm::vec3 &p0 = vertices[i0].position;
+            const glm::vec3 &p1 = vertices[i1].position;
+            glm::vec3 edge = p1 - p0;
+            glm::vec3 edgeNormal = glm::cross(edge, normal);
+            float edgeLength = glm::length(edgeNormal);
+            if (edgeLength == 0.0f) {
+                continue;
+            }
+            edgeNormal /= edgeLength;
+            double edgeDistance = -glm::dot(edgeNormal, p0);
+            double weight = glm::dot(edge, edge) * (seam ? kSeamWeight : kBorderWeight);
+            quadrics[remap[i0]].AddPlane(edgeNormal, edgeDistance, weight);
+            quadrics[remap[i1]].AddPlane(edgeNormal, edgeDistance, weight);
+        }
+    }
+    return quadrics;
+}
+
+/**
+ * Triangles touching each position, keyed by remap representative.
+ */
+Adjacency BuildTriangleAdjacency(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &remap) {
+    Adjacency triangles;
+    triangles.offsets.assign(remap.size() + 1, 0);
+    for (unsigned int v : indices) {
+        triangles.offsets[remap[v] + 1]++;
+    }
+    for (size_t v = 0; v < remap.size(); v++) {
+        triangles.offsets[v + 1] += triangles.offsets[v];
+    }
+    triangles.items.resize(indices.size());
+    std::vector<unsigned int> fill(triangles.offsets.begin(), triangles.offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        triangles.items[fill[remap[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+    }
+    return triangles;
+}
+
+bool CanCollapse(unsigned int i0, unsigned int i1, const std::vector<VertexKind> &kinds,
+                 const std::vector<unsigned int> &remap, const std::vector<unsigned int> &wedge,
+                 const std::vector<unsigned int> &loop, const std::vector<unsigned int> &loopback) {
+    VertexKind k0 = kinds[i0];
+    if (remap[i0] == remap[i1] || !kCanCollapse[k0][kinds[i1]]) {
+        return false;
+    }
+    if (k0 == KIND_BORDER || k0 == KIND_SEAM) {
+        // slide along the border or seam only
+        if (loop[i0] != i1 && loopback[i0] != i1) {
+            return false;
+        }
+    }
+    if (k0 == KIND_SEAM) {
+        // the other side of the seam has to collapse along the same edge
+        unsigned int s0 = wedge[i0], s1 = wedge[i1];
+        if (loop[s0] != s1 && loopback[s0] != s1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * True if moving every corner at position r0 onto p1 keeps the surrounding triangles
+ * from folding over.
+ */
+bool KeepsOrientation(const std::vector<VertexPTN> &vertices, const std::vector<unsigned int> &indices,
+                      const Adjacency &triangles, const std::vector<unsigned int> &remap,
+                      unsigned int r0, unsigned int r1, const glm::vec3 &p1) {
+    for (const unsigned int *t = triangles.begin(r0); t != triangles.end(r0); t++) {
+        const unsigned int *corners = &indices[*t * 3];
+        glm::vec3 before[3], after[3];
+        bool collapses = false;
+        for (int k = 0; k < 3; k++) {
+            before[k] = vertices[corners[k]].position;
+            after[k] = remap[corners[k]] == r0 ? p1 : before[k];
+            collapses = collapses || remap[corners[k]] == r1;
+        }
+        if (collapses) {
+            continue;
+        }
+        glm::vec3 normalBefore = TriangleNormal(before[0], before[1], before[2]);
+        glm::vec3 normalAfter = TriangleNormal(after[0], after[1], after[2]);
+        if (glm::dot(normalBefore, normalAfter) <=
+            kFlipThreshold * glm::length(normalBefore) * glm::length(normalAfter)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Keep the open-edge loops walkable after i0 merges into its loop neighbour i1.
+ */
+void UpdateLoops(unsigned int i0, unsigned int i1, std::vector<unsigned int> &loop,
+                 std::vector<unsigned int> &loopback) {
+    unsigned int prev = loopback[i0], next = loop[i0];
+    if (next == i1) {
+        loopback[i1] = prev;
+        if (prev != kNone && loop[prev] == i0) {
+            loop[prev] = i1;
+        }
+    } else if (prev == i1) {
+        loop[i1] = next;
+        if (next != kNone && loopback[next] == i0) {
+            loopback[next] = i1;
+        }
+    }
+}
+
+}
+
+std::vector<unsigned int> SimplifyMesh(const std::vector<VertexPTN> &vertices, const unsigned int *indices,
+                                       size_t indexCount, size_t targetIndexCount, float targetError,
+                                       float *resultError) {
+    std::vector<unsigned int> result(indices, indices + indexCount);
+    if (resultError) {
+        *resultError = 0.0f;
+    }
+    if (targetIndexCount >= indexCount || vertices.empty()) {
+        return result;
+    }
+
+    std::vector<unsigned int> remap, wedge, loop, loopback;
+    BuildPositionRemap(vertices, remap, wedge);
+    Adjacency edges = BuildHalfEdges(result, vertices.size());
+    BuildOpenEdgeLoops(edges, loop, loopback);
+    std::vector<VertexKind> kinds = ClassifyVertices(remap, wedge, loop, loopback);
+    std::vector<Quadric> quadrics = BuildQuadrics(vertices, result, edges, remap, wedge);
+
+    glm::vec3 boundsMin = vertices[0].position, boundsMax = boundsMin;
+    for (const VertexPTN &vertex : vertices) {
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+    glm::vec3 size = boundsMax - boundsMin;
+    double extent = std::max(size.x, std::max(size.y, size.z));
+    double maxCost = (targetError * extent) * (targetError * extent);
+    double worstCost = 0.0;
+
+    std::vector<unsigned int> collapseRemap(vertices.size());
+    std::vector<unsigned char> locked(vertices.size());
+    std::vector<Collapse> collapses;
+
+    // each pass collapses a set of edges with disjoint neighbourhoods, cheapest first
+    while (result.size() > targetIndexCount) {
+        collapses.clear();
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = result[t + k], b = result[t + (k + 1) % 3];
+                bool forward = CanCollapse(a, b, kinds, remap, wedge, loop, loopback);
+                bool backward = CanCollapse(b, a, kinds, remap, wedge, loop, loopback);
+                double forwardCost = forward ? quadrics[remap[a]].Evaluate(vertices[b].position) : 0.0;
+                double backwardCost = backward ? quadrics[remap[b]].Evaluate(vertices[a].position) : 0.0;
+                if (forward && (!backward || forwardCost <= backwardCost)) {
+                    collapses.push_back(Collapse{a, b, forwardCost});
+                } else if (backward) {
+                    collapses.push_back(Collapse{b, a, backwardCost});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            if (a.cost != b.cost) return a.cost < b.cost;
+            if (a.v0 != b.v0) return a.v0 < b.v0;
+            return a.v1 < b.v1;
+        });
+
+        Adjacency triangles = BuildTriangleAdjacency(result, remap);
+        for (size_t v = 0; v < vertices.size(); v++) {
+            collapseRemap[v] = static_cast<unsigned int>(v);
+        }
+        std::fill(locked.begin(), locked.end(), 0);
+
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0, performed = 0;
+        for (const Collapse &collapse : collapses) {
+            if (collapse.cost > maxCost || removed >= trianglesToRemove) {
+                break;
+            }
+            unsigned int i0 = collapse.v0, i1 = collapse.v1;
+            unsigned int r0 = remap[i0], r1 = remap[i1];
+            if (locked[r0] || locked[r1]) {
+                continue;
+            }
+            if (!KeepsOrientation(vertices, result, triangles, remap, r0, r1, vertices[i1].position)) {
+                continue;
+            }
+
+            collapseRemap[i0] = i1;
+            UpdateLoops(i0, i1, loop, loopback);
+            if (kinds[i0] == KIND_SEAM) {
+                collapseRemap[wedge[i0]] = wedge[i1];
+                UpdateLoops(wedge[i0], wedge[i1], loop, loopback);
+            }
+            quadrics[r1].Add(quadrics[r0]);
+            worstCost = std::max(worstCost, collapse.cost);
+
+            // freeze the whole neighbourhood so later collapses this pass see the positions
+            // their orientation checks assumed
+            for (const unsigned int *t = triangles.begin(r0); t != triangles.end(r0); t++) {
+                for (int k = 0; k < 3; k++) {
+                    locked[remap[result[*t * 3 + k]]] = 1;
+                }
+            }
+            removed += kinds[i0] == KIND_BORDER ? 1 : 2;
+            performed++;
+        }
+        if (performed == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            unsigned int a = collapseRemap[result[t]];
+            unsigned int b = collapseRemap[result[t + 1]];
+            unsigned int c = collapseRemap[result[t + 2]];
+            if (a != b && b != c && a != c) {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        result.resize(write);
+    }
+
+    if (resultError) {
+        *resultError = extent > 0.0 ? static_cast<float>(std::sqrt(worstCost) / extent) : 0.0f;
+    }
+    return result;
+}
+
+void GenerateMeshLods(MeshData &mesh, const std::vector<LodTarget> &targets) {
+    size_t fullCount = mesh.lods.empty() ? mesh.indices.size() : mesh.lods[0].indexCount;
+    std::vector<unsigned int> full(mesh.indices.begin(), mesh.indices.begin() + fullCount);
+
+    mesh.indices.resize(fullCount);
+    mesh.lods.assign(1, MeshLod{0, static_cast<unsigned int>(fullCount), 0.0f});
+
+    for (const LodTarget &target : targets) {
+        size_t targetCount = static_cast<size_t>(fullCount / 3 * target.triangleRatio) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = SimplifyMesh(mesh.vertices, full.data(), full.size(), targetCount,
+                                                     target.maxError, &error);
+        if (lod.empty() || lod.size() >= mesh.lods.back().indexCount) {
+            continue;
+        }
+        OptimizeVertexCache(lod, mesh.vertices.size());
+
+        MeshLod level{static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), error};
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        mesh.lods.push_back(level);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "MeshData.h"
+
+/**
+ * One level of a LOD chain: keep this fraction of the full mesh's triangles, unless
+ * that would move the surface further than maxError (relative to the mesh extent).
+ */
+struct LodTarget {
+    float triangleRatio;
+    float maxError;
+};
+
+/**
+ * Simplify a triangle list with quadric error metrics by collapsing edges onto existing
+ * vertices, so the result indexes the same vertex buffer. Vertices on open borders and
+ * UV seams only slide along the border or seam, so neither tears. The result depends only
+ * on the input, never on timing or memory layout, so it can be cached.
+ * @param vertices Vertex buffer the indices refer to.
+ * @param indices Triangle list indices.
+ * @param indexCount Number of indices.
+ * @param targetIndexCount Stop once the result has this many indices or fewer.
+ * @param targetError Largest allowed error, relative to the mesh extent (0.01 = 1%).
+ * @param resultError Set to the error of the result, relative to the mesh extent.
+ * @return Indices of the simplified triangle list.
+ */
+std::vector<unsigned int> SimplifyMesh(const std::vector<VertexPTN> &vertices, const unsigned int *indices,
+                                       size_t indexCount, size_t targetIndexCount, float targetError,
+                                       float *resultError = nullptr);
+
+/**
+ * Build a LOD chain from mesh.indices, simplifying the full mesh once per target. Each
+ * level is cache-optimised and appended to mesh.indices, and mesh.lods records the index
+ * ranges with lods[0] being the full mesh. Levels that fail to drop below the previous
+ * level's triangle count are left out.
+ */
+void GenerateMeshLods(MeshData &mesh, const std::vector<LodTarget> &targets);
+
+#endif //MESHSIMPLIFIER_H
@@ -0,0 +1,143 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// cones whose triangles spread wider than this are not worth testing
+const float kMinConeSpread = 0.1f;
+
+void FinishMeshlet(const MeshView &mesh, const std::vector<unsigned int> &vertices, Meshlet &meshlet) {
+    meshlet.vertexCount = static_cast<unsigned int>(vertices.size());
+
+    // bounding sphere around the AABB centre: cheap and conservative
+    glm::vec3 boundsMin = mesh.vertices[vertices[0]].position, boundsMax = boundsMin;
+    for (unsigned int v : vertices) {
+        boundsMin = glm::min(boundsMin, mesh.vertices[v].position);
+        boundsMax = glm::max(boundsMax, mesh.vertices[v].position);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (unsigned int v : vertices) {
+        meshlet.radius = std::max(meshlet.radius, glm::length(mesh.vertices[v].position - meshlet.center));
+    }
+
+    // normal cone: the average normal, widened to cover every triangle
+    const unsigned int *indices = mesh.indices + meshlet.indexOffset;
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (unsigned int t = 0; t < meshlet.triangleCount; t++) {
+        const glm::vec3 &a = mesh.vertices[indices[t * 3]].position;
+        const glm::vec3 &b = mesh.vertices[indices[t * 3 + 1]].position;
+        const glm::vec3 &c = mesh.vertices[indices[t * 3 + 2]].position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        normals.push_back(normal);
+        axis += normal;
+    }
+
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    float axisLength = glm::length(axis);
+    if (axisLength == 0.0f) {
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3 &normal : normals) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+    }
+    if (minDot <= kMinConeSpread) {
+        return;
+    }
+
+    // move the apex back along the axis until every triangle plane is in front of it
+    float maxT = 0.0f;
+    for (unsigned int t = 0; t < meshlet.triangleCount; t++) {
+        const glm::vec3 &a = mesh.vertices[indices[t * 3]].position;
+        float dc = glm::dot(meshlet.center - a, normals[t]);
+        float dn = glm::dot(axis, normals[t]);
+        maxT = std::max(maxT, dc / dn);
+    }
+
+    meshlet.coneApex = meshlet.center - axis * maxT;
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+}
+
+std::vector<Meshlet> BuildMeshlets(const MeshView &mesh, unsigned int maxVertices, unsigned int maxTriangles) {
+    std::vector<Meshlet> meshlets;
+    if (mesh.indexCount < 3) {
+        return meshlets;
+    }
+
+    // stamp[v] == meshlets.size() + 1 marks vertices already in the current meshlet
+    std::vector<unsigned int> stamp(mesh.vertexCount, 0);
+    std::vector<unsigned int> vertices;
+    vertices.reserve(maxVertices);
+
+    Meshlet current = {};
+    for (size_t t = 0; t + 2 < mesh.indexCount; t += 3) {
+        unsigned int id = static_cast<unsigned int>(meshlets.size()) + 1;
+        unsigned int a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+        unsigned int newVertices = (stamp[a] != id) + (stamp[b] != id && b != a) +
+                                   (stamp[c] != id && c != a && c != b);
+
+        if (current.triangleCount + 1 > maxTriangles || vertices.size() + newVertices > maxVertices) {
+            FinishMeshlet(mesh, vertices, current);
+            meshlets.push_back(current);
+            vertices.clear();
+            current = Meshlet{};
+            current.indexOffset = static_cast<unsigned int>(t);
+            id++;
+        }
+
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = mesh.indices[t + k];
+            if (stamp[v] != id) {
+                stamp[v] = id;
+                vertices.push_back(v);
+            }
+        }
+        current.triangleCount++;
+    }
+    FinishMeshlet(mesh, vertices, current);
+    meshlets.push_back(current);
+    return meshlets;
+}
+
+MeshletStats AnalyzeMeshlets(const std::vector<Meshlet> &meshlets, unsigned int maxVertices,
+                             unsigned int maxTriangles) {
+    MeshletStats stats;
+    stats.meshletCount = meshlets.size();
+    if (meshlets.empty()) {
+        return stats;
+    }
+    size_t vertexTotal = 0, triangleTotal = 0;
+    for (const Meshlet &meshlet : meshlets) {
+        vertexTotal += meshlet.vertexCount;
+        triangleTotal += meshlet.triangleCount;
+    }
+    stats.averageVertices = float(vertexTotal) / float(meshlets.size());
+    stats.averageTriangles = float(triangleTotal) / float(meshlets.size());
+    stats.vertexFill = stats.averageVertices / float(maxVertices);
+    stats.triangleFill = stats.averageTriangles / float(maxTriangles);
+    return stats;
+}
+
+bool IsMeshletBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPosition) {
+    if (meshlet.coneCutoff >= 1.0f) {
+        return false;
+    }
+    glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+    float distance = glm::length(toApex);
+    return distance > 0.0f && glm::dot(toApex / distance, meshlet.coneAxis) >= meshlet.coneCutoff;
+}
@@ -0,0 +1,64 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+/**
+ * A small cluster of triangles stored as a contiguous range of the index buffer,
+ * with a bounding sphere and a normal cone for cluster-level culling.
+ */
+struct Meshlet {
+    unsigned int indexOffset;
+    unsigned int triangleCount;
+    unsigned int vertexCount;
+    glm::vec3 center;
+    float radius;
+    // every triangle faces away from cameras inside the cone around -coneAxis at coneApex;
+    // coneCutoff >= 1 means the cone is too wide to ever cull
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// per-frame counters for meshlet culling
+struct MeshletCullStats {
+    unsigned int tested = 0;
+    unsigned int frustumCulled = 0;
+    unsigned int backfaceCulled = 0;
+    unsigned int trianglesDrawn = 0;
+};
+
+struct MeshletStats {
+    size_t meshletCount = 0;
+    float averageVertices = 0.0f;
+    float averageTriangles = 0.0f;
+    // average fill of the vertex and triangle limits, 0..1
+    float vertexFill = 0.0f;
+    float triangleFill = 0.0f;
+};
+
+/**
+ * Split a mesh into meshlets by scanning its index buffer in order, so each meshlet
+ * stays a contiguous index range and the cache-optimised order is preserved.
+ * @param mesh Vertices and indices to cluster.
+ * @param maxVertices Largest number of unique vertices per meshlet.
+ * @param maxTriangles Largest number of triangles per meshlet.
+ */
+std::vector<Meshlet> BuildMeshlets(const MeshView &mesh, unsigned int maxVertices = 64,
+                                   unsigned int maxTriangles = 124);
+
+MeshletStats AnalyzeMeshlets(const std::vector<Meshlet> &meshlets, unsigned int maxVertices = 64,
+                             unsigned int maxTriangles = 124);
+
+/**
+ * True if every triangle of the meshlet faces away from the camera.
+ * @param cameraPosition Camera position in the mesh's model space.
+ */
+bool IsMeshletBackfacing(const Meshlet &meshlet, const glm::vec3 &cameraPosition);
+
+#endif //MESHLET_H
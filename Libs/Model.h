@@ -2,7 +2,9 @@
 #define MODEL_H
 
 #include <string>
+#include <vector>
 #include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
 
 struct Model {
     std::string modelPath;
@@ -10,6 +12,13 @@ struct Model {
     glm::vec3 position;
     float scale = 1.0f;
     bool flipTexture = true;
+    // rasterised into the occlusion buffer to hide the models behind it
+    bool occluder = false;
+    // draw inside a conditional render on last frame's bounding box occlusion query
+    bool occlusionQuery = false;
+    // world-space placements applied after position and scale; with any, the model is drawn
+    // once per placement in one instanced draw instead of once as is
+    std::vector<glm::mat4> instances{};
 };
 
 #endif //MODEL_H
@@ -0,0 +1,138 @@
+#include "MultiDrawIndirect.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+#include "Mesh.h"
+
+static const char *VERTEX_SHADER = "Shaders/multidraw.vert";
+static const char *FRAGMENT_SHADER = "Shaders/multidraw.frag";
+// binding of the Draws block in multidraw.vert
+static const GLuint DRAW_DATA_BINDING = 0;
+
+MultiDrawIndirect::MultiDrawIndirect() {
+    ready = false;
+    drawDataBuffer = 0;
+    commandBuffer = 0;
+}
+
+MultiDrawIndirect::~MultiDrawIndirect() {
+    Release();
+}
+
+bool MultiDrawIndirect::IsSupported() {
+    return GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters;
+}
+
+bool MultiDrawIndirect::Initialise() {
+    Release();
+    if (!IsSupported()) {
+        std::cout << "Multi-draw indirect needs OpenGL 4.3 and ARB_shader_draw_parameters, drawing one model at a time"
+                  << std::endl;
+        return false;
+    }
+
+    shader.CreateFromFiles(VERTEX_SHADER, FRAGMENT_SHADER);
+    if (!shader.IsValid()) {
+        std::cout << "Multi-draw shaders failed to build, drawing one model at a time" << std::endl;
+        Release();
+        return false;
+    }
+    shader.UseShader();
+    shader.SetUniform("texture2D", 0);
+    glUseProgram(0);
+
+    glGenBuffers(1, &drawDataBuffer);
+    glGenBuffers(1, &commandBuffer);
+    ready = true;
+    return true;
+}
+
+void MultiDrawIndirect::Release() {
+    for (GLuint *buffer : {&drawDataBuffer, &commandBuffer}) {
+        if (*buffer != 0) {
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+    }
+    shader.ClearShader();
+    queue.clear();
+    ready = false;
+}
+
+void MultiDrawIndirect::Add(const Mesh &mesh, unsigned int lod, const glm::mat4 &model, GLuint texture) {
+    if (mesh.GetHeap() == nullptr || mesh.GetLodCount() == 0) {
+        return;
+    }
+    QueuedDraw draw;
+    draw.heap = mesh.GetHeap();
+    draw.indexType = mesh.GetIndexType();
+    draw.texture = texture;
+    draw.range = mesh.GetDrawRange(std::min(lod, mesh.GetLodCount() - 1));
+    draw.data.model = model;
+    draw.data.positionScale = glm::vec4(mesh.GetPositionScale(), 0.0f);
+    draw.data.positionOffset = glm::vec4(mesh.GetPositionOffset(), 0.0f);
+    draw.data.octahedralNormals = mesh.HasOctahedralNormals() ? 1u : 0u;
+    draw.data.padding[0] = draw.data.padding[1] = draw.data.padding[2] = 0;
+    queue.push_back(draw);
+}
+
+MultiDrawStats MultiDrawIndirect::Submit() {
+    MultiDrawStats stats;
+    if (!ready || queue.empty()) {
+        queue.clear();
+        return stats;
+    }
+
+    // draws that can share a call end up next to each other
+    std::sort(queue.begin(), queue.end(), [](const QueuedDraw &a, const QueuedDraw &b) {
+        if (a.heap != b.heap) {
+            return std::less<GeometryHeap *>()(a.heap, b.heap);
+        }
+        if (a.indexType != b.indexType) {
+            return a.indexType < b.indexType;
+        }
+        return a.texture < b.texture;
+    });
+
+    drawData.clear();
+    commands.clear();
+    batches.clear();
+    for (QueuedDraw &draw : queue) {
+        Batch *batch = batches.empty() ? nullptr : &batches.back();
+        if (batch == nullptr || batch->heap != draw.heap || batch->indexType != draw.indexType ||
+            batch->texture != draw.texture) {
+            batches.push_back(Batch{draw.heap, draw.indexType, draw.texture, commands.size(), 0});
+            batch = &batches.back();
+        }
+        drawData.push_back(draw.data);
+        commands.push_back(DrawCommand{draw.range.indexCount, 1, draw.range.firstIndex, draw.range.baseVertex, 0});
+        batch->count++;
+    }
+    queue.clear();
+
+    // orphan last frame's contents rather than wait for the GPU to finish with them
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), drawData.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STREAM_DRAW);
+
+    shader.UseShader();
+    for (const Batch &batch : batches) {
+        batch.heap->Bind();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, batch.texture);
+        // gl_DrawIDARB restarts at 0 for every call
+        shader.SetUniform("drawOffset", static_cast<GLuint>(batch.first));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+                                    reinterpret_cast<const void *>(batch.first * sizeof(DrawCommand)),
+                                    static_cast<GLsizei>(batch.count), 0);
+        stats.draws += static_cast<unsigned int>(batch.count);
+        stats.calls++;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return stats;
+}
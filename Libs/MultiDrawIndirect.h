@@ -0,0 +1,106 @@
+#ifndef MULTIDRAWINDIRECT_H
+#define MULTIDRAWINDIRECT_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "GeometryHeap.h"
+#include "Shader.h"
+
+class Mesh;
+
+struct MultiDrawStats {
+    unsigned int draws = 0;
+    unsigned int calls = 0;
+};
+
+/**
+ * Whole-scene submission with glMultiDrawElementsIndirect, for OpenGL 4.3 contexts with
+ * ARB_shader_draw_parameters. Draws are collected with Add and issued by Submit, which
+ * writes one DrawElementsIndirectCommand and one DrawData per draw and then makes a
+ * single call for each run of draws that share a geometry heap, an index type and a
+ * texture. The shaders read the model matrix from a storage buffer indexed by
+ * gl_DrawIDARB, so the call count grows with the number of textures rather than objects.
+ */
+class MultiDrawIndirect {
+public:
+    MultiDrawIndirect();
+    ~MultiDrawIndirect();
+
+    MultiDrawIndirect(const MultiDrawIndirect &) = delete;
+    MultiDrawIndirect &operator=(const MultiDrawIndirect &) = delete;
+
+    /**
+     * True if the current context has multi-draw indirect and gl_DrawIDARB.
+     */
+    static bool IsSupported();
+
+    /**
+     * Load the shaders and create the buffers.
+     * @return false if the context lacks support or a shader failed to build.
+     */
+    bool Initialise();
+    bool IsReady() const { return ready; }
+
+    /**
+     * Queue a LOD of mesh, placed by model and sampled from texture.
+     */
+    void Add(const Mesh &mesh, unsigned int lod, const glm::mat4 &model, GLuint texture);
+
+    /**
+     * Issue every queued draw with the multi-draw program and clear the queue. The camera and
+     * light come from the Frame block FrameUniforms bound for this frame. The program stays
+     * bound, so rebind the caller's own afterwards.
+     */
+    MultiDrawStats Submit();
+
+private:
+    // std430 layout of DrawData in multidraw.vert
+    struct DrawData {
+        glm::mat4 model;
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        GLuint octahedralNormals;
+        GLuint padding[3];
+    };
+
+    // DrawElementsIndirectCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct QueuedDraw {
+        GeometryHeap *heap;
+        GLenum indexType;
+        GLuint texture;
+        DrawRange range;
+        DrawData data;
+    };
+
+    // consecutive draws issued by one glMultiDrawElementsIndirect
+    struct Batch {
+        GeometryHeap *heap;
+        GLenum indexType;
+        GLuint texture;
+        size_t first, count;
+    };
+
+    bool ready;
+    Shader shader;
+    GLuint drawDataBuffer, commandBuffer;
+    std::vector<QueuedDraw> queue;
+    std::vector<DrawData> drawData;
+    std::vector<DrawCommand> commands;
+    std::vector<Batch> batches;
+
+    void Release();
+};
+
+#endif //MULTIDRAWINDIRECT_H
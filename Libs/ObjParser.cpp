@@ -0,0 +1,380 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "VertexIndexTable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool IsBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+inline const char *SkipBlanks(const char *p, const char *end) {
+    while (p < end && IsBlank(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+inline const char *SkipLine(const char *p, const char *end) {
+    const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+/**
+ * Parse a decimal float in the style of std::from_chars: no locale, no copies.
+ * Up to 19 significant digits are accumulated in an integer and scaled once by a
+ * power of ten, which is exact for the short literals OBJ exporters write.
+ * @return Pointer past the number, or p itself if no number was found.
+ */
+const char *ParseFloat(const char *p, const char *end, float &out) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+
+    for (; p < end && IsDigit(*p); ++p) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        for (; p < end && IsDigit(*p); ++p) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any) {
+        return start;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+        if (q < end && IsDigit(*q)) {
+            int e = 0;
+            for (; q < end && IsDigit(*q); ++q) {
+                if (e < 10000) {
+                    e = e * 10 + (*q - '0');
+                }
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = static_cast<double>(mantissa);
+    if (exponent < 0) {
+        value = exponent >= -22 ? value / kPow10[-exponent] : value * std::pow(10.0, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * kPow10[exponent] : value * std::pow(10.0, exponent);
+    }
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+/**
+ * Parse a signed decimal integer.
+ * @return Pointer past the number, or p itself if no number was found.
+ */
+const char *ParseInt(const char *p, const char *end, int &out) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p >= end || !IsDigit(*p)) {
+        return start;
+    }
+    int value = 0;
+    for (; p < end && IsDigit(*p); ++p) {
+        value = value * 10 + (*p - '0');
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+/**
+ * Look up a 1-based OBJ attribute, falling back to zero when the corner has none.
+ */
+template <typename T>
+T FetchAttribute(const std::vector<T> &values, int index) {
+    if (index < 1 || index > static_cast<int>(values.size())) {
+        return T(0.0f);
+    }
+    return values[index - 1];
+}
+
+// below this many bytes per chunk the thread start-up outweighs the parsing
+const size_t kMinChunkBytes = 64 * 1024;
+
+/**
+ * Turn a relative (negative) OBJ reference into an absolute 1-based index.
+ */
+inline int ResolveIndex(int index, size_t count) {
+    return index < 0 ? static_cast<int>(count) + index + 1 : index;
+}
+
+/**
+ * Per-thread parse result. Relative references are resolved against the chunk's
+ * own counts, and their slots (face * 9 + attribute * 3 + corner) are recorded so
+ * the merge pass can add the global offsets of the preceding chunks.
+ */
+struct ObjChunk {
+    ObjData data;
+    std::vector<uint32_t> relativeSlots;
+};
+
+const char *ParseVec(const char *p, const char *end, float *dst, int n) {
+    for (int i = 0; i < n; i++) {
+        p = SkipBlanks(p, end);
+        p = ParseFloat(p, end, dst[i]);
+    }
+    return p;
+}
+
+const char *ParseFaceLine(const char *p, const char *end, ObjData &out, std::vector<uint32_t> *relativeSlots) {
+    int first[4] = {0, 0, 0, 0};
+    int prev[4] = {0, 0, 0, 0};
+    int count = 0;
+
+    while (true) {
+        p = SkipBlanks(p, end);
+        int corner[4] = {0, 0, 0, 0};
+        const char *q = ParseInt(p, end, corner[0]);
+        if (q == p) {
+            break;
+        }
+        p = q;
+        if (p < end && *p == '/') {
+            ++p;
+            p = ParseInt(p, end, corner[1]);
+            if (p < end && *p == '/') {
+                ++p;
+                p = ParseInt(p, end, corner[2]);
+            }
+        }
+        int relativeMask = (corner[0] < 0) | (corner[1] < 0) << 1 | (corner[2] < 0) << 2;
+        corner[0] = ResolveIndex(corner[0], out.positions.size());
+        corner[1] = ResolveIndex(corner[1], out.texCoords.size());
+        corner[2] = ResolveIndex(corner[2], out.normals.size());
+        corner[3] = relativeMask;
+
+        if (count == 0) {
+            memcpy(first, corner, sizeof(corner));
+        } else if (count >= 2) {
+            // fan-triangulate polygons around the first corner
+            Face face;
+            uint32_t faceSlot = static_cast<uint32_t>(out.faces.size()) * 9;
+            for (int k = 0; k < 3; k++) {
+                const int *src = k == 0 ? first : (k == 1 ? prev : corner);
+                face.vIndex[k] = src[0];
+                face.vtIndex[k] = src[1];
+                face.vnIndex[k] = src[2];
+                if (src[3] != 0 && relativeSlots != nullptr) {
+                    for (int attribute = 0; attribute < 3; attribute++) {
+                        if (src[3] & (1 << attribute)) {
+                            relativeSlots->push_back(faceSlot + attribute * 3 + k);
+                        }
+                    }
+                }
+            }
+            out.faces.push_back(face);
+        }
+        memcpy(prev, corner, sizeof(corner));
+        count++;
+    }
+    return p;
+}
+
+void ParseRange(const char *begin, const char *end, ObjData &out, std::vector<uint32_t> *relativeSlots) {
+    const char *p = begin;
+    while (p < end) {
+        p = SkipBlanks(p, end);
+        if (p + 1 < end && IsBlank(p[1])) {
+            if (*p == 'v') {
+                glm::vec3 vertex(0.0f);
+                p = ParseVec(p + 2, end, &vertex.x, 3);
+                out.positions.push_back(vertex);
+            } else if (*p == 'f') {
+                p = ParseFaceLine(p + 2, end, out, relativeSlots);
+            }
+        } else if (p + 2 < end && *p == 'v' && IsBlank(p[2])) {
+            if (p[1] == 't') {
+                glm::vec2 texCoord(0.0f);
+                p = ParseVec(p + 3, end, &texCoord.x, 2);
+                out.texCoords.push_back(texCoord);
+            } else if (p[1] == 'n') {
+                glm::vec3 normal(0.0f);
+                p = ParseVec(p + 3, end, &normal.x, 3);
+                out.normals.push_back(normal);
+            }
+        }
+        if (p < end) {
+            p = SkipLine(p, end);
+        }
+    }
+}
+
+/**
+ * Copy one chunk into its slice of the merged arrays and rebase its relative references.
+ */
+void MergeChunk(const ObjChunk &chunk, ObjData &out, size_t positionBase, size_t texCoordBase,
+                size_t normalBase, size_t faceBase) {
+    const ObjData &data = chunk.data;
+    std::copy(data.positions.begin(), data.positions.end(), out.positions.begin() + positionBase);
+    std::copy(data.texCoords.begin(), data.texCoords.end(), out.texCoords.begin() + texCoordBase);
+    std::copy(data.normals.begin(), data.normals.end(), out.normals.begin() + normalBase);
+    std::copy(data.faces.begin(), data.faces.end(), out.faces.begin() + faceBase);
+
+    const int offsets[3] = {
+        static_cast<int>(positionBase), static_cast<int>(texCoordBase), static_cast<int>(normalBase)
+    };
+    for (uint32_t slot : chunk.relativeSlots) {
+        Face &face = out.faces[faceBase + slot / 9];
+        int attribute = (slot % 9) / 3;
+        int corner = slot % 3;
+        int *indices = attribute == 0 ? face.vIndex : (attribute == 1 ? face.vtIndex : face.vnIndex);
+        indices[corner] += offsets[attribute];
+    }
+}
+
+}
+
+void ParseOBJBuffer(const char *begin, const char *end, ObjData &out) {
+    ParseRange(begin, end, out, nullptr);
+}
+
+void ParseOBJBufferParallel(const char *begin, const char *end, ObjData &out, unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t size = end - begin;
+    size_t chunkCount = std::min<size_t>(threadCount, std::max<size_t>(1, size / kMinChunkBytes));
+    if (chunkCount <= 1) {
+        ParseRange(begin, end, out, nullptr);
+        return;
+    }
+
+    // split at line boundaries so no line straddles two chunks
+    std::vector<const char *> bounds(chunkCount + 1);
+    bounds[0] = begin;
+    bounds[chunkCount] = end;
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char *split = std::max(begin + size * i / chunkCount, bounds[i - 1]);
+        const char *newline = static_cast<const char *>(memchr(split, '\n', end - split));
+        bounds[i] = newline ? newline + 1 : end;
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunkCount; i++) {
+        workers.emplace_back([&chunks, &bounds, i]() {
+            ParseRange(bounds[i], bounds[i + 1], chunks[i].data, &chunks[i].relativeSlots);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // prefix sums give every chunk the global base of each stream
+    std::vector<size_t> positionBase(chunkCount), texCoordBase(chunkCount), normalBase(chunkCount), faceBase(chunkCount);
+    size_t positionCount = 0, texCoordCount = 0, normalCount = 0, faceCount = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        positionBase[i] = positionCount;
+        texCoordBase[i] = texCoordCount;
+        normalBase[i] = normalCount;
+        faceBase[i] = faceCount;
+        positionCount += chunks[i].data.positions.size();
+        texCoordCount += chunks[i].data.texCoords.size();
+        normalCount += chunks[i].data.normals.size();
+        faceCount += chunks[i].data.faces.size();
+    }
+    out.positions.resize(positionCount);
+    out.texCoords.resize(texCoordCount);
+    out.normals.resize(normalCount);
+    out.faces.resize(faceCount);
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        workers.emplace_back([&, i]() {
+            MergeChunk(chunks[i], out, positionBase[i], texCoordBase[i], normalBase[i], faceBase[i]);
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+bool ParseOBJ(const char *path, ObjData &out, unsigned int threadCount) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        return false;
+    }
+
+    const char *begin = file.GetData();
+    out.sourceBytes = file.GetSize();
+    ParseOBJBufferParallel(begin, begin + file.GetSize(), out, threadCount);
+    return true;
+}
+
+void BuildMeshData(const ObjData &obj, MeshData &out) {
+    out.vertices.clear();
+    out.indices.clear();
+    out.indices.reserve(obj.faces.size() * 3);
+
+    // key on the (v, vt, vn) index triple; the table is sized from the face count so it never grows
+    VertexIndexTable vertexToIndex(obj.faces.size() * 3);
+
+    for (const Face &face : obj.faces) {
+        for (int i = 0; i < 3; i++) {
+            bool inserted;
+            unsigned int index = vertexToIndex.findOrInsert(face.vIndex[i], face.vtIndex[i], face.vnIndex[i],
+                                                            out.vertices.size(), inserted);
+            if (inserted) {
+                VertexPTN vertex;
+                vertex.position = FetchAttribute(obj.positions, face.vIndex[i]);
+                vertex.texCoord = FetchAttribute(obj.texCoords, face.vtIndex[i]);
+                vertex.normal = FetchAttribute(obj.normals, face.vnIndex[i]);
+                out.vertices.push_back(vertex);
+            }
+            out.indices.push_back(index);
+        }
+    }
+    ComputeMeshBounds(out);
+}
@@ -0,0 +1,68 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+/**
+ * One triangle of an OBJ file. Indices are 1-based and already resolved
+ * (negative references are made absolute); 0 means the attribute is absent.
+ */
+struct Face {
+    int vIndex[3], vtIndex[3], vnIndex[3];
+};
+
+/**
+ * Raw attribute streams and triangulated faces of an OBJ file, in file order.
+ */
+struct ObjData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<Face> faces;
+    size_t sourceBytes = 0;
+};
+
+/**
+ * Memory-map an OBJ file and parse it in place.
+ * @param path The path to the OBJ file.
+ * @param out Receives the parsed attribute streams and faces.
+ * @param threadCount Worker threads to parse with; 0 uses one per hardware thread.
+ * @return false if the file could not be opened.
+ */
+bool ParseOBJ(const char *path, ObjData &out, unsigned int threadCount = 0);
+
+/**
+ * Parse OBJ text from a buffer. Lines are scanned in place and never copied.
+ * Accepts v, v/vt, v//vn and v/vt/vn corners, negative indices and polygons,
+ * which are fan-triangulated.
+ * @param begin Start of the OBJ text.
+ * @param end One past the last byte of the OBJ text.
+ * @param out Receives the parsed attribute streams and faces.
+ */
+void ParseOBJBuffer(const char *begin, const char *end, ObjData &out);
+
+/**
+ * Parse OBJ text on several threads. The buffer is split at line boundaries,
+ * each chunk is parsed into its own attribute and face arrays, and a merge pass
+ * concatenates them and rebases relative (negative) indices to global ones.
+ * Small buffers are parsed on fewer threads so the split never costs more than it saves.
+ * @param begin Start of the OBJ text.
+ * @param end One past the last byte of the OBJ text.
+ * @param out Receives the parsed attribute streams and faces.
+ * @param threadCount Worker threads to parse with; 0 uses one per hardware thread.
+ */
+void ParseOBJBufferParallel(const char *begin, const char *end, ObjData &out, unsigned int threadCount);
+
+/**
+ * Deduplicate the face corners of parsed OBJ data into an indexed mesh and compute its bounds.
+ * @param obj The parsed OBJ data.
+ * @param out Receives the unique vertices and the index buffer.
+ */
+void BuildMeshData(const ObjData &obj, MeshData &out);
+
+#endif //OBJPARSER_H
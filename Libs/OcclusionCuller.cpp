@@ -0,0 +1,333 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+// Triangles are clipped to this multiple of the viewport on each side, which keeps the
+// edge function coefficients small enough for float precision.
+static const float GUARD_BAND = 2.0f;
+// Sutherland-Hodgman against five planes can add one vertex per plane
+static const int MAX_CLIPPED_VERTICES = 8;
+
+OccluderMesh BuildOccluderMesh(const MeshView &mesh, float maxError) {
+    size_t indexOffset = 0, indexCount = mesh.GetFullIndexCount();
+    for (size_t i = 1; i < mesh.lodCount; i++) {
+        if (mesh.lods[i].error <= maxError) {
+            indexOffset = mesh.lods[i].indexOffset;
+            indexCount = mesh.lods[i].indexCount;
+        }
+    }
+
+    OccluderMesh occluder;
+    std::vector<unsigned int> remap(mesh.vertexCount, ~0u);
+    occluder.indices.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i++) {
+        unsigned int vertex = mesh.indices[indexOffset + i];
+        if (remap[vertex] == ~0u) {
+            remap[vertex] = static_cast<unsigned int>(occluder.positions.size());
+            occluder.positions.push_back(mesh.vertices[vertex].position);
+        }
+        occluder.indices.push_back(remap[vertex]);
+    }
+    return occluder;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, unsigned int threadCount) : nextTile(0) {
+    tilesX = std::max(1, (width + TILE_SIZE - 1) / TILE_SIZE);
+    tilesY = std::max(1, (height + TILE_SIZE - 1) / TILE_SIZE);
+    this->width = tilesX * TILE_SIZE;
+    this->height = tilesY * TILE_SIZE;
+    depth.assign(static_cast<size_t>(this->width) * this->height, 1.0f);
+    tileBins.resize(static_cast<size_t>(tilesX) * tilesY);
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // the calling thread rasterises too
+    for (unsigned int i = 1; i < threadCount; i++) {
+        workers.emplace_back(&OcclusionCuller::WorkerLoop, this);
+    }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4 &viewProjection) {
+    this->viewProjection = viewProjection;
+    triangles.clear();
+    for (std::vector<unsigned int> &bin : tileBins) {
+        bin.clear();
+    }
+    stats = OcclusionStats();
+}
+
+// Clip a convex polygon to plane . v >= 0 in clip space.
+static int ClipPolygon(const glm::vec4 *in, int count, const glm::vec4 &plane, glm::vec4 *out) {
+    int outCount = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec4 &a = in[i], &b = in[(i + 1) % count];
+        float da = glm::dot(plane, a), db = glm::dot(plane, b);
+        if (da >= 0.0f) {
+            out[outCount++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            out[outCount++] = a + (b - a) * (da / (da - db));
+        }
+    }
+    return outCount;
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh &mesh, const glm::mat4 &model) {
+    auto start = std::chrono::steady_clock::now();
+    glm::mat4 transform = viewProjection * model;
+    std::vector<glm::vec4> clip(mesh.positions.size());
+    for (size_t i = 0; i < mesh.positions.size(); i++) {
+        clip[i] = transform * glm::vec4(mesh.positions[i], 1.0f);
+    }
+
+    // near plane z >= -w, then the guard band on x and y
+    const glm::vec4 planes[5] = {
+            glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+            glm::vec4(1.0f, 0.0f, 0.0f, GUARD_BAND), glm::vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+            glm::vec4(0.0f, 1.0f, 0.0f, GUARD_BAND), glm::vec4(0.0f, -1.0f, 0.0f, GUARD_BAND),
+    };
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const glm::vec4 &a = clip[mesh.indices[i]], &b = clip[mesh.indices[i + 1]], &c = clip[mesh.indices[i + 2]];
+        // trivially reject triangles entirely outside one plane, accept those inside all
+        bool inside = true, outside = false;
+        for (const glm::vec4 &plane : planes) {
+            float da = glm::dot(plane, a), db = glm::dot(plane, b), dc = glm::dot(plane, c);
+            inside = inside && da >= 0.0f && db >= 0.0f && dc >= 0.0f;
+            outside = outside || (da < 0.0f && db < 0.0f && dc < 0.0f);
+        }
+        if (outside) {
+            continue;
+        }
+        if (inside) {
+            SetupTriangle(a, b, c);
+            continue;
+        }
+
+        glm::vec4 polygon[2][MAX_CLIPPED_VERTICES + 1] = {{a, b, c}};
+        int count = 3, current = 0;
+        for (const glm::vec4 &plane : planes) {
+            count = ClipPolygon(polygon[current], count, plane, polygon[1 - current]);
+            current = 1 - current;
+            if (count < 3) {
+                break;
+            }
+        }
+        for (int v = 1; v + 1 < count; v++) {
+            SetupTriangle(polygon[current][0], polygon[current][v], polygon[current][v + 1]);
+        }
+    }
+    stats.rasterizeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::SetupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2) {
+    // to pixels, y up like the framebuffer; depth in the [0, 1] window range
+    float x[3], y[3], z[3];
+    const glm::vec4 *v[3] = {&v0, &v1, &v2};
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / v[i]->w;
+        x[i] = (v[i]->x * invW * 0.5f + 0.5f) * width;
+        y[i] = (v[i]->y * invW * 0.5f + 0.5f) * height;
+        z[i] = v[i]->z * invW * 0.5f + 0.5f;
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+        return;
+    }
+    // both windings occlude; make the triangle counter-clockwise so inside is positive
+    if (area < 0.0f) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    Triangle triangle;
+    triangle.minX = std::max(0, static_cast<int>(std::floor(std::min(x[0], std::min(x[1], x[2])))));
+    triangle.minY = std::max(0, static_cast<int>(std::floor(std::min(y[0], std::min(y[1], y[2])))));
+    triangle.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(x[0], std::max(x[1], x[2])))));
+    triangle.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(y[0], std::max(y[1], y[2])))));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int j = (i + 1) % 3;
+        triangle.edgeA[i] = y[i] - y[j];
+        triangle.edgeB[i] = x[j] - x[i];
+        triangle.edgeC[i] = -(triangle.edgeA[i] * x[i] + triangle.edgeB[i] * y[i]);
+    }
+    triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+
+    unsigned int index = static_cast<unsigned int>(triangles.size());
+    triangles.push_back(triangle);
+    stats.occluderTriangles++;
+    for (int ty = triangle.minY / TILE_SIZE; ty <= triangle.maxY / TILE_SIZE; ty++) {
+        for (int tx = triangle.minX / TILE_SIZE; tx <= triangle.maxX / TILE_SIZE; tx++) {
+            tileBins[ty * tilesX + tx].push_back(index);
+        }
+    }
+}
+
+void OcclusionCuller::Rasterize() {
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        nextTile = 0;
+        busyWorkers = static_cast<unsigned int>(workers.size());
+        generation++;
+    }
+    wakeWorkers.notify_all();
+    RasterizeTiles();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        workersDone.wait(lock, [this] { return busyWorkers == 0; });
+    }
+    stats.rasterizeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void OcclusionCuller::WorkerLoop() {
+    unsigned int seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+        RasterizeTiles();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            workersDone.notify_one();
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeTiles() {
+    unsigned int tileCount = static_cast<unsigned int>(tileBins.size());
+    for (unsigned int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+        RasterizeTile(tile);
+    }
+}
+
+void OcclusionCuller::RasterizeTile(unsigned int tile) {
+    // each tile is a contiguous TILE_SIZE x TILE_SIZE block of the depth buffer
+    float *tileDepth = &depth[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE];
+    std::fill(tileDepth, tileDepth + TILE_SIZE * TILE_SIZE, 1.0f);
+    int tileX = static_cast<int>(tile % tilesX) * TILE_SIZE, tileY = static_cast<int>(tile / tilesX) * TILE_SIZE;
+
+    for (unsigned int index : tileBins[tile]) {
+        const Triangle &triangle = triangles[index];
+        // start on a 4-pixel boundary; pixels past the triangle's box fail the edge tests
+        int x0 = (std::max(triangle.minX, tileX) - tileX) & ~3;
+        int x1 = std::min(triangle.maxX, tileX + TILE_SIZE - 1) - tileX;
+        int y0 = std::max(triangle.minY, tileY) - tileY;
+        int y1 = std::min(triangle.maxY, tileY + TILE_SIZE - 1) - tileY;
+
+#ifdef OCCLUSION_USE_SSE
+        __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]), edgeA1 = _mm_set1_ps(triangle.edgeA[1]), edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+        __m128 depthA = _mm_set1_ps(triangle.depthA);
+        __m128 zero = _mm_setzero_ps();
+        for (int y = y0; y <= y1; y++) {
+            float py = static_cast<float>(tileY + y) + 0.5f;
+            __m128 row0 = _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]);
+            __m128 row1 = _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]);
+            __m128 row2 = _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]);
+            __m128 rowDepth = _mm_set1_ps(triangle.depthB * py + triangle.depthC);
+            float *rowPixels = tileDepth + y * TILE_SIZE;
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(tileX + x)), laneOffsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA0, px), row0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA1, px), row1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA2, px), row2);
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+                __m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth);
+                __m128 old = _mm_loadu_ps(rowPixels + x);
+                __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(rowPixels + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++) {
+            float py = static_cast<float>(tileY + y) + 0.5f;
+            float *rowPixels = tileDepth + y * TILE_SIZE;
+            for (int x = x0; x <= x1; x++) {
+                float px = static_cast<float>(tileX + x) + 0.5f;
+                bool inside = true;
+                for (int e = 0; e < 3; e++) {
+                    inside = inside && triangle.edgeA[e] * px + triangle.edgeB[e] * py + triangle.edgeC[e] >= 0.0f;
+                }
+                if (inside) {
+                    float z = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+                    rowPixels[x] = std::min(rowPixels[x], z);
+                }
+            }
+        }
+#endif
+    }
+}
+
+float OcclusionCuller::GetDepth(int x, int y) const {
+    int tile = (y / TILE_SIZE) * tilesX + x / TILE_SIZE;
+    return depth[static_cast<size_t>(tile) * TILE_SIZE * TILE_SIZE + (y % TILE_SIZE) * TILE_SIZE + x % TILE_SIZE];
+}
+
+bool OcclusionCuller::IsBoxVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const {
+    float minX = static_cast<float>(width), minY = static_cast<float>(height), maxX = 0.0f, maxY = 0.0f;
+    float nearestDepth = 1.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 position(corner & 1 ? boxMax.x : boxMin.x, corner & 2 ? boxMax.y : boxMin.y, corner & 4 ? boxMax.z : boxMin.z);
+        glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+        if (clip.z < -clip.w || clip.w <= 0.0f) {
+            return true;
+        }
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * width, y = (clip.y * invW * 0.5f + 0.5f) * height;
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+        nearestDepth = std::min(nearestDepth, clip.z * invW * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor(minX))), x1 = std::min(width - 1, static_cast<int>(std::ceil(maxX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY))), y1 = std::min(height - 1, static_cast<int>(std::ceil(maxY)));
+    if (x0 > x1 || y0 > y1) {
+        return true;
+    }
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (nearestDepth <= GetDepth(x, y)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,109 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+/**
+ * CPU-side copy of the geometry a mesh contributes as an occluder.
+ */
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+};
+
+/**
+ * Extract occluder geometry from the coarsest LOD whose simplification error is at most
+ * maxError (relative to the mesh extent), keeping only the vertices it references.
+ */
+OccluderMesh BuildOccluderMesh(const MeshView &mesh, float maxError);
+
+struct OcclusionStats {
+    unsigned int occluderTriangles = 0;
+    double rasterizeMs = 0.0;
+};
+
+/**
+ * Software occlusion culling. A few occluders are rasterised into a low-resolution depth
+ * buffer split into tiles; triangles are set up and binned on the calling thread, then
+ * worker threads each fill whole tiles with 4-wide SIMD edge functions, so no two threads
+ * ever touch the same pixels. Objects are then tested by the screen rectangle and nearest
+ * depth of their bounding box.
+ */
+class OcclusionCuller {
+public:
+    static const int TILE_SIZE = 32;
+
+    /**
+     * @param width Depth buffer width in pixels; rounded up to whole tiles.
+     * @param height Depth buffer height in pixels; rounded up to whole tiles.
+     * @param threadCount Rasteriser threads including the caller; 0 means one per hardware thread.
+     */
+    OcclusionCuller(int width, int height, unsigned int threadCount = 0);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    /**
+     * Clear the depth buffer and the occluder list for a new view.
+     */
+    void BeginFrame(const glm::mat4 &viewProjection);
+
+    /**
+     * Transform, clip and bin an occluder's triangles.
+     */
+    void AddOccluder(const OccluderMesh &mesh, const glm::mat4 &model);
+
+    /**
+     * Fill the depth buffer from the binned triangles on the worker threads.
+     */
+    void Rasterize();
+
+    /**
+     * True unless the box is certainly hidden behind the rasterised occluders. Boxes that
+     * cross the near plane or lie off screen count as visible.
+     */
+    bool IsBoxVisible(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+
+    const OcclusionStats &GetStats() const { return stats; }
+
+private:
+    // screen-space triangle as three edge functions and a depth plane, each a*x + b*y + c
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    int width, height, tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<float> depth;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<unsigned int>> tileBins;
+    OcclusionStats stats;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers, workersDone;
+    unsigned int generation = 0;
+    unsigned int busyWorkers = 0;
+    bool stopping = false;
+    std::atomic<unsigned int> nextTile;
+
+    void SetupTriangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2);
+    void WorkerLoop();
+    void RasterizeTiles();
+    void RasterizeTile(unsigned int tile);
+    float GetDepth(int x, int y) const;
+};
+
+#endif //OCCLUSIONCULLER_H
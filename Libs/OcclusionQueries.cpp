@@ -0,0 +1,126 @@
+#include "OcclusionQueries.h"
+
+#include <algorithm>
+
+static const char *BOX_VERTEX_SHADER = "Shaders/bbox.vert";
+static const char *BOX_FRAGMENT_SHADER = "Shaders/bbox.frag";
+// boxes this close to the camera are not queried, so the near plane cannot clip them open
+static const float CAMERA_MARGIN = 0.5f;
+
+OcclusionQueries::OcclusionQueries() {
+    boxVAO = 0;
+    boxVBO = 0;
+    boxIBO = 0;
+}
+
+OcclusionQueries::~OcclusionQueries() {
+    SetObjectCount(0);
+    if (boxIBO != 0) {
+        glDeleteBuffers(1, &boxIBO);
+    }
+    if (boxVBO != 0) {
+        glDeleteBuffers(1, &boxVBO);
+    }
+    if (boxVAO != 0) {
+        glDeleteVertexArrays(1, &boxVAO);
+    }
+}
+
+void OcclusionQueries::Initialise() {
+    boxShader.CreateFromFiles(BOX_VERTEX_SHADER, BOX_FRAGMENT_SHADER);
+
+    const GLfloat corners[] = {
+            0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+    };
+    // both windings are fine: face culling is off while the boxes are drawn
+    const GLubyte faces[] = {
+            0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6,
+            0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6,
+            0, 2, 6, 0, 6, 4, 1, 3, 7, 1, 7, 5,
+    };
+    glGenVertexArrays(1, &boxVAO);
+    glBindVertexArray(boxVAO);
+    glGenBuffers(1, &boxVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), nullptr);
+    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &boxIBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxIBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void OcclusionQueries::SetObjectCount(size_t count) {
+    for (size_t i = count; i < objects.size(); i++) {
+        glDeleteQueries(2, objects[i].queries);
+    }
+    size_t first = objects.size();
+    objects.resize(count);
+    for (size_t i = first; i < count; i++) {
+        glGenQueries(2, objects[i].queries);
+    }
+}
+
+bool OcclusionQueries::BeginConditionalRender(size_t i) {
+    if (i >= objects.size() || objects[i].current < 0) {
+        return false;
+    }
+    // an unfinished query counts as visible rather than stalling
+    glBeginConditionalRender(objects[i].queries[objects[i].current], GL_QUERY_NO_WAIT);
+    return true;
+}
+
+void OcclusionQueries::EndConditionalRender() {
+    glEndConditionalRender();
+}
+
+void OcclusionQueries::IssueQueries(const std::vector<Bounds> &worldBounds, const std::vector<unsigned char> &enabled,
+                                    const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition) {
+    SetObjectCount(worldBounds.size());
+
+    boxShader.UseShader();
+    boxShader.SetUniform("viewProjection", viewProjection);
+    glBindVertexArray(boxVAO);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+
+    for (size_t i = 0; i < objects.size(); i++) {
+        QueryObject &object = objects[i];
+        if (object.current >= 0) {
+            // last frame's query has had a frame to finish; take it only if it has
+            GLuint available = 0;
+            glGetQueryObjectuiv(object.queries[object.current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint anySamples = 0;
+                glGetQueryObjectuiv(object.queries[object.current], GL_QUERY_RESULT, &anySamples);
+                object.stats.results++;
+                object.stats.occluded += anySamples == 0;
+            }
+        }
+
+        const Bounds &bounds = worldBounds[i];
+        glm::vec3 outside = glm::max(bounds.boxMin - cameraPosition, cameraPosition - bounds.boxMax);
+        bool cameraInside = std::max(outside.x, std::max(outside.y, outside.z)) <= CAMERA_MARGIN;
+        if (i >= enabled.size() || !enabled[i] || cameraInside) {
+            object.current = -1;
+            continue;
+        }
+
+        int next = object.current == 0 ? 1 : 0;
+        boxShader.SetUniform("boxMin", bounds.boxMin);
+        boxShader.SetUniform("boxMax", bounds.boxMax);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, object.queries[next]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        object.current = next;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,81 @@
+#ifndef OCCLUSIONQUERIES_H
+#define OCCLUSIONQUERIES_H
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Shader.h"
+
+/**
+ * Per-object results of the box queries, for judging whether querying an asset pays off.
+ */
+struct OcclusionQueryStats {
+    // query results read back, and how many of them found the box hidden
+    unsigned int results = 0;
+    unsigned int occluded = 0;
+
+    // fraction of frames the object's draw was skipped
+    float GetHitRate() const { return results > 0 ? static_cast<float>(occluded) / results : 0.0f; }
+};
+
+/**
+ * Hardware occlusion queries with conditional rendering. After a frame's draws, the
+ * bounding box of each enabled object is drawn with colour and depth writes off inside a
+ * GL_ANY_SAMPLES_PASSED query. The next frame draws the object inside
+ * glBeginConditionalRender on that query with GL_QUERY_NO_WAIT, so the GPU skips hidden
+ * objects and the CPU never waits for a result. Each object alternates between two
+ * queries so one can be read while the other is being written.
+ */
+class OcclusionQueries {
+public:
+    OcclusionQueries();
+    ~OcclusionQueries();
+
+    OcclusionQueries(const OcclusionQueries &) = delete;
+    OcclusionQueries &operator=(const OcclusionQueries &) = delete;
+
+    /**
+     * Build the box shader and the unit cube it draws.
+     */
+    void Initialise();
+
+    /**
+     * Size the per-object queries; objects added since the last call start unconditional.
+     */
+    void SetObjectCount(size_t count);
+
+    /**
+     * Start conditional rendering on object i's last query.
+     * @return false, and nothing started, if the object has no query result pending.
+     */
+    bool BeginConditionalRender(size_t i);
+    void EndConditionalRender();
+
+    /**
+     * Collect finished results and query the boxes of the enabled objects against the
+     * current depth buffer. Objects whose box contains the camera are drawn unconditionally.
+     * Leaves no program bound.
+     */
+    void IssueQueries(const std::vector<Bounds> &worldBounds, const std::vector<unsigned char> &enabled,
+                      const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition);
+
+    const OcclusionQueryStats &GetStats(size_t i) const { return objects[i].stats; }
+
+private:
+    struct QueryObject {
+        GLuint queries[2] = {0, 0};
+        // the query the next frame renders against, -1 for none
+        int current = -1;
+        OcclusionQueryStats stats;
+    };
+
+    std::vector<QueryObject> objects;
+    Shader boxShader;
+    GLuint boxVAO, boxVBO, boxIBO;
+};
+
+#endif //OCCLUSIONQUERIES_H
@@ -0,0 +1,171 @@
+#include "PotentiallyVisibleSet.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+const char kMagic[8] = {'P', 'V', 'S', 'B', 'I', 'T', 'S', '\0'};
+
+struct PvsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t objectCount;
+    float origin[3];
+    float cellSize;
+    uint32_t dims[3];
+    uint32_t rowCount;
+};
+
+}
+
+void PotentiallyVisibleSet::Create(const glm::vec3 &origin, float cellSize, const uint32_t dims[3], uint32_t objectCount) {
+    this->origin = origin;
+    this->cellSize = cellSize;
+    memcpy(this->dims, dims, sizeof(this->dims));
+    this->objectCount = objectCount;
+    rowBytes = (objectCount + 7) / 8;
+    size_t cellCount = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+    cellRows.resize(cellCount);
+    for (size_t i = 0; i < cellCount; i++) {
+        cellRows[i] = static_cast<uint32_t>(i);
+    }
+    rows.assign(cellCount * rowBytes, 0);
+}
+
+void PotentiallyVisibleSet::SetVisible(size_t cell, uint32_t object) {
+    rows[cellRows[cell] * rowBytes + object / 8] |= static_cast<uint8_t>(1u << (object % 8));
+}
+
+void PotentiallyVisibleSet::SetAllVisible(size_t cell) {
+    for (uint32_t object = 0; object < objectCount; object++) {
+        SetVisible(cell, object);
+    }
+}
+
+void PotentiallyVisibleSet::Merge(size_t cell, const PotentiallyVisibleSet &source, size_t sourceCell) {
+    uint8_t *row = &rows[cellRows[cell] * rowBytes];
+    const uint8_t *otherRow = &source.rows[source.cellRows[sourceCell] * rowBytes];
+    for (size_t i = 0; i < rowBytes; i++) {
+        row[i] |= otherRow[i];
+    }
+}
+
+bool PotentiallyVisibleSet::Write(const char *path) const {
+    // share rows between cells with the same bitset
+    std::unordered_map<std::string, uint32_t> uniqueRows;
+    std::vector<uint32_t> outCellRows(cellRows.size());
+    std::vector<uint8_t> outRows;
+    for (size_t cell = 0; cell < cellRows.size(); cell++) {
+        std::string key(reinterpret_cast<const char *>(&rows[cellRows[cell] * rowBytes]), rowBytes);
+        auto inserted = uniqueRows.emplace(key, static_cast<uint32_t>(uniqueRows.size()));
+        if (inserted.second) {
+            outRows.insert(outRows.end(), key.begin(), key.end());
+        }
+        outCellRows[cell] = inserted.first->second;
+    }
+
+    PvsHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = VERSION;
+    header.objectCount = objectCount;
+    memcpy(header.origin, &origin[0], sizeof(header.origin));
+    header.cellSize = cellSize;
+    memcpy(header.dims, dims, sizeof(header.dims));
+    header.rowCount = static_cast<uint32_t>(uniqueRows.size());
+
+    std::string tempPath = std::string(path) + ".tmp";
+    FILE *out = fopen(tempPath.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    ok = ok && fwrite(outCellRows.data(), sizeof(uint32_t), outCellRows.size(), out) == outCellRows.size();
+    ok = ok && fwrite(outRows.data(), 1, outRows.size(), out) == outRows.size();
+    ok = fclose(out) == 0 && ok;
+    if (ok) {
+        std::error_code error;
+        std::filesystem::rename(tempPath, path, error);
+        ok = !error;
+    }
+    if (!ok) {
+        std::remove(tempPath.c_str());
+    }
+    return ok;
+}
+
+bool PotentiallyVisibleSet::Load(const char *path, uint32_t expectedObjectCount) {
+    cellRows.clear();
+    rows.clear();
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        return false;
+    }
+
+    PvsHeader header;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+              header.version == VERSION && header.objectCount == expectedObjectCount && header.cellSize > 0.0f;
+    size_t cellCount = ok ? static_cast<size_t>(header.dims[0]) * header.dims[1] * header.dims[2] : 0;
+    size_t headerRowBytes = (static_cast<size_t>(header.objectCount) + 7) / 8;
+    if (ok) {
+        // check the size before allocating anything a corrupt header asks for
+        std::error_code error;
+        uint64_t fileSize = std::filesystem::file_size(path, error);
+        ok = !error && fileSize == sizeof(header) + cellCount * sizeof(uint32_t) +
+                                   static_cast<uint64_t>(header.rowCount) * headerRowBytes;
+    }
+    if (ok) {
+        cellRows.resize(cellCount);
+        rows.resize(static_cast<size_t>(header.rowCount) * headerRowBytes);
+        ok = fread(cellRows.data(), sizeof(uint32_t), cellCount, in) == cellCount &&
+             fread(rows.data(), 1, rows.size(), in) == rows.size();
+    }
+    for (size_t cell = 0; ok && cell < cellCount; cell++) {
+        ok = cellRows[cell] < header.rowCount;
+    }
+    fclose(in);
+
+    if (!ok || cellCount == 0) {
+        cellRows.clear();
+        rows.clear();
+        return false;
+    }
+    origin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+    cellSize = header.cellSize;
+    memcpy(dims, header.dims, sizeof(dims));
+    objectCount = header.objectCount;
+    rowBytes = headerRowBytes;
+    return true;
+}
+
+long PotentiallyVisibleSet::FindCell(const glm::vec3 &point) const {
+    glm::vec3 local = (point - origin) / cellSize;
+    uint32_t cell[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float coordinate = std::floor(local[axis]);
+        if (!(coordinate >= 0.0f && coordinate < static_cast<float>(dims[axis]))) {
+            return -1;
+        }
+        cell[axis] = static_cast<uint32_t>(coordinate);
+    }
+    return static_cast<long>(GetCellIndex(cell[0], cell[1], cell[2]));
+}
+
+unsigned int PotentiallyVisibleSet::Cull(const glm::vec3 &cameraPosition, std::vector<unsigned char> &visible) const {
+    long cell = IsLoaded() ? FindCell(cameraPosition) : -1;
+    if (cell < 0) {
+        return 0;
+    }
+    unsigned int rejected = 0;
+    for (size_t i = 0; i < visible.size() && i < objectCount; i++) {
+        if (visible[i] && !IsVisible(static_cast<size_t>(cell), static_cast<uint32_t>(i))) {
+            visible[i] = 0;
+            rejected++;
+        }
+    }
+    return rejected;
+}
@@ -0,0 +1,78 @@
+#ifndef POTENTIALLYVISIBLESET_H
+#define POTENTIALLYVISIBLESET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Precomputed visibility: the scene is split into a uniform grid of camera cells, and each
+ * cell holds a bitset of the objects that can be seen from anywhere inside it. pvs-bake
+ * computes and writes the file; the viewer loads it and looks up the camera's cell.
+ * Cells with identical bitsets share one row on disk and in memory.
+ */
+class PotentiallyVisibleSet {
+public:
+    // bump whenever the file layout changes
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Start an empty set (every bit clear) over dims cells of cellSize from origin.
+     */
+    void Create(const glm::vec3 &origin, float cellSize, const uint32_t dims[3], uint32_t objectCount);
+
+    void SetVisible(size_t cell, uint32_t object);
+    void SetAllVisible(size_t cell);
+    // OR the bits of source's sourceCell into cell, which must still have its own row as after Create
+    void Merge(size_t cell, const PotentiallyVisibleSet &source, size_t sourceCell);
+
+    /**
+     * Write the set, sharing rows between cells with identical bitsets.
+     */
+    bool Write(const char *path) const;
+
+    /**
+     * @return false if the file is missing or malformed, or holds a different number of objects.
+     */
+    bool Load(const char *path, uint32_t expectedObjectCount);
+
+    bool IsLoaded() const { return !cellRows.empty(); }
+
+    /**
+     * Grid cell containing the point, or -1 outside the grid.
+     */
+    long FindCell(const glm::vec3 &point) const;
+    size_t GetCellIndex(uint32_t x, uint32_t y, uint32_t z) const { return (static_cast<size_t>(z) * dims[1] + y) * dims[0] + x; }
+
+    bool IsVisible(size_t cell, uint32_t object) const {
+        return (rows[cellRows[cell] * rowBytes + object / 8] >> (object % 8)) & 1;
+    }
+
+    /**
+     * Clear visible[i] for objects outside the camera cell's set. Nothing is rejected when
+     * the camera is outside the grid.
+     * @return the number of objects rejected.
+     */
+    unsigned int Cull(const glm::vec3 &cameraPosition, std::vector<unsigned char> &visible) const;
+
+    const glm::vec3 &GetOrigin() const { return origin; }
+    float GetCellSize() const { return cellSize; }
+    const uint32_t *GetDims() const { return dims; }
+    size_t GetCellCount() const { return cellRows.size(); }
+    size_t GetRowCount() const { return rowBytes > 0 ? rows.size() / rowBytes : 0; }
+    uint32_t GetObjectCount() const { return objectCount; }
+
+private:
+    glm::vec3 origin = glm::vec3(0.0f);
+    float cellSize = 1.0f;
+    uint32_t dims[3] = {0, 0, 0};
+    uint32_t objectCount = 0;
+    size_t rowBytes = 0;
+    // row of each cell, and the rows' bitsets back to back
+    std::vector<uint32_t> cellRows;
+    std::vector<uint8_t> rows;
+};
+
+#endif //POTENTIALLYVISIBLESET_H
@@ -0,0 +1,352 @@
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int kBinCount = 16;
+// leaves stop splitting at this size unless the SAH still finds a cheaper split
+const unsigned int kMaxLeafObjects = 4;
+// relative cost of visiting a node versus testing an object
+const float kTraversalCost = 1.0f;
+// deeper nodes become leaves, which bounds the fixed-size traversal stacks
+const unsigned int kMaxDepth = 48;
+const int kStackSize = kMaxDepth + 2;
+
+float HalfArea(const glm::vec3 &boxMin, const glm::vec3 &boxMax) {
+    glm::vec3 e = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+struct Bin {
+    glm::vec3 boxMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boxMax = glm::vec3(-std::numeric_limits<float>::max());
+    unsigned int count = 0;
+
+    void Grow(const glm::vec3 &otherMin, const glm::vec3 &otherMax) {
+        boxMin = glm::min(boxMin, otherMin);
+        boxMax = glm::max(boxMax, otherMax);
+    }
+};
+
+/**
+ * Entry and exit distance of a ray through a box (slab test).
+ */
+bool IntersectBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const glm::vec3 &boxMin,
+                  const glm::vec3 &boxMax, float &entry, float &exit) {
+    glm::vec3 t0 = (boxMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boxMax - origin) * inverseDirection;
+    glm::vec3 nearT = glm::min(t0, t1), farT = glm::max(t0, t1);
+    entry = std::max(nearT.x, std::max(nearT.y, nearT.z));
+    exit = std::min(farT.x, std::min(farT.y, farT.z));
+    return entry <= exit;
+}
+
+bool OverlapsSphere(const glm::vec3 &boxMin, const glm::vec3 &boxMax, const glm::vec3 &center, float radius) {
+    glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+    glm::vec3 d = closest - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+}
+
+void SceneBVH::Build(const std::vector<Bounds> &objects) {
+    objectCount = objects.size();
+    nodes.clear();
+    objectIndices.resize(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        objectIndices[i] = static_cast<unsigned int>(i);
+    }
+    if (objectCount == 0) {
+        objectBoxes.clear();
+        return;
+    }
+
+    std::vector<glm::vec3> centroids(objectCount);
+    for (size_t i = 0; i < objectCount; i++) {
+        centroids[i] = objects[i].GetBoxCenter();
+    }
+
+    nodes.reserve(objectCount * 2);
+    nodes.push_back(Node{glm::vec3(0.0f), 0, glm::vec3(0.0f), static_cast<unsigned int>(objectCount)});
+    UpdateNodeBounds(0, objects);
+
+    // children are always appended after their parent, which Refit relies on
+    struct Pending {
+        unsigned int node;
+        unsigned int depth;
+    };
+    std::vector<Pending> stack(1, Pending{0, 0});
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        if (pending.depth < kMaxDepth && SplitNode(pending.node, objects, centroids)) {
+            stack.push_back(Pending{nodes[pending.node].leftOrFirst, pending.depth + 1});
+            stack.push_back(Pending{nodes[pending.node].leftOrFirst + 1, pending.depth + 1});
+        }
+    }
+
+    objectBoxes.resize(objectCount * 2);
+    for (size_t k = 0; k < objectCount; k++) {
+        objectBoxes[k * 2] = objects[objectIndices[k]].boxMin;
+        objectBoxes[k * 2 + 1] = objects[objectIndices[k]].boxMax;
+    }
+}
+
+void SceneBVH::Refit(const std::vector<Bounds> &objects) {
+    for (size_t k = 0; k < objectCount; k++) {
+        objectBoxes[k * 2] = objects[objectIndices[k]].boxMin;
+        objectBoxes[k * 2 + 1] = objects[objectIndices[k]].boxMax;
+    }
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node &node = nodes[i];
+        if (node.count > 0) {
+            node.boxMin = objectBoxes[node.leftOrFirst * 2];
+            node.boxMax = objectBoxes[node.leftOrFirst * 2 + 1];
+            for (unsigned int k = node.leftOrFirst + 1; k < node.leftOrFirst + node.count; k++) {
+                node.boxMin = glm::min(node.boxMin, objectBoxes[k * 2]);
+                node.boxMax = glm::max(node.boxMax, objectBoxes[k * 2 + 1]);
+            }
+        } else {
+            const Node &left = nodes[node.leftOrFirst], &right = nodes[node.leftOrFirst + 1];
+            node.boxMin = glm::min(left.boxMin, right.boxMin);
+            node.boxMax = glm::max(left.boxMax, right.boxMax);
+        }
+    }
+}
+
+void SceneBVH::QueryFrustum(const Frustum &frustum, std::vector<unsigned char> &visible) const {
+    visible.assign(objectCount, 0);
+    if (nodes.empty()) {
+        return;
+    }
+
+    glm::vec3 absNormals[6];
+    for (int p = 0; p < 6; p++) {
+        absNormals[p] = glm::abs(glm::vec3(frustum.planes[p]));
+    }
+    // false if the box is outside; planes the box is entirely inside are cleared from mask
+    auto classify = [&](const glm::vec3 &boxMin, const glm::vec3 &boxMax, unsigned int &mask) {
+        glm::vec3 center = (boxMin + boxMax) * 0.5f, extent = (boxMax - boxMin) * 0.5f;
+        for (int p = 0; p < 6; p++) {
+            if (!(mask & (1u << p))) {
+                continue;
+            }
+            float d = glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w;
+            float r = glm::dot(absNormals[p], extent);
+            if (d + r < 0.0f) {
+                return false;
+            }
+            if (d - r >= 0.0f) {
+                mask &= ~(1u << p);
+            }
+        }
+        return true;
+    };
+
+    struct Entry {
+        unsigned int node;
+        unsigned int mask;
+    };
+    Entry stack[kStackSize];
+    int top = 0;
+    stack[top++] = Entry{0, 0x3Fu};
+    while (top > 0) {
+        Entry entry = stack[--top];
+        const Node &node = nodes[entry.node];
+        unsigned int mask = entry.mask;
+        if (mask != 0 && !classify(node.boxMin, node.boxMax, mask)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (unsigned int k = node.leftOrFirst; k < node.leftOrFirst + node.count; k++) {
+                unsigned int objectMask = mask;
+                if (objectMask == 0 || classify(objectBoxes[k * 2], objectBoxes[k * 2 + 1], objectMask)) {
+                    visible[objectIndices[k]] = 1;
+                }
+            }
+        } else {
+            stack[top++] = Entry{node.leftOrFirst, mask};
+            stack[top++] = Entry{node.leftOrFirst + 1, mask};
+        }
+    }
+}
+
+bool SceneBVH::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RayHit &hit) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    glm::vec3 inverseDirection;
+    for (int axis = 0; axis < 3; axis++) {
+        // a huge finite value instead of infinity keeps 0 * inf NaNs out of the slab test
+        inverseDirection[axis] = std::fabs(direction[axis]) > 1e-20f ? 1.0f / direction[axis]
+                                                                     : std::copysign(1e30f, direction[axis]);
+    }
+
+    float best = maxDistance;
+    bool found = false;
+    unsigned int stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        float entry, exit;
+        if (!IntersectBox(origin, inverseDirection, node.boxMin, node.boxMax, entry, exit) || exit < 0.0f ||
+            entry > best) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (unsigned int k = node.leftOrFirst; k < node.leftOrFirst + node.count; k++) {
+                if (IntersectBox(origin, inverseDirection, objectBoxes[k * 2], objectBoxes[k * 2 + 1], entry, exit) &&
+                    entry >= 0.0f && entry <= best) {
+                    best = entry;
+                    hit.object = objectIndices[k];
+                    hit.distance = entry;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // visit the nearer child first so the far one is usually rejected by best
+        unsigned int first = node.leftOrFirst, second = node.leftOrFirst + 1;
+        float firstEntry, secondEntry, unused;
+        bool firstHit = IntersectBox(origin, inverseDirection, nodes[first].boxMin, nodes[first].boxMax, firstEntry, unused);
+        bool secondHit = IntersectBox(origin, inverseDirection, nodes[second].boxMin, nodes[second].boxMax, secondEntry, unused);
+        if (firstHit && secondHit && secondEntry < firstEntry) {
+            std::swap(first, second);
+        }
+        if (firstHit || secondHit) {
+            stack[top++] = second;
+            stack[top++] = first;
+        }
+    }
+    return found;
+}
+
+void SceneBVH::QuerySphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &objects) const {
+    objects.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    unsigned int stack[kStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        if (!OverlapsSphere(node.boxMin, node.boxMax, center, radius)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (unsigned int k = node.leftOrFirst; k < node.leftOrFirst + node.count; k++) {
+                if (OverlapsSphere(objectBoxes[k * 2], objectBoxes[k * 2 + 1], center, radius)) {
+                    objects.push_back(objectIndices[k]);
+                }
+            }
+        } else {
+            stack[top++] = node.leftOrFirst;
+            stack[top++] = node.leftOrFirst + 1;
+        }
+    }
+}
+
+void SceneBVH::UpdateNodeBounds(unsigned int nodeIndex, const std::vector<Bounds> &objects) {
+    Node &node = nodes[nodeIndex];
+    node.boxMin = glm::vec3(std::numeric_limits<float>::max());
+    node.boxMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (unsigned int k = node.leftOrFirst; k < node.leftOrFirst + node.count; k++) {
+        node.boxMin = glm::min(node.boxMin, objects[objectIndices[k]].boxMin);
+        node.boxMax = glm::max(node.boxMax, objects[objectIndices[k]].boxMax);
+    }
+}
+
+bool SceneBVH::SplitNode(unsigned int nodeIndex, const std::vector<Bounds> &objects,
+                         const std::vector<glm::vec3> &centroids) {
+    unsigned int first = nodes[nodeIndex].leftOrFirst, count = nodes[nodeIndex].count;
+    if (count <= 1) {
+        return false;
+    }
+
+    glm::vec3 centroidMin = centroids[objectIndices[first]], centroidMax = centroidMin;
+    for (unsigned int k = first + 1; k < first + count; k++) {
+        centroidMin = glm::min(centroidMin, centroids[objectIndices[k]]);
+        centroidMax = glm::max(centroidMax, centroids[objectIndices[k]]);
+    }
+
+    // binned SAH: sweep the bin boundaries of each axis for the cheapest split
+    int bestAxis = -1, bestSplit = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float scale = kBinCount / extent;
+        Bin bins[kBinCount];
+        for (unsigned int k = first; k < first + count; k++) {
+            const Bounds &object = objects[objectIndices[k]];
+            int bin = std::min(kBinCount - 1, static_cast<int>((centroids[objectIndices[k]][axis] - centroidMin[axis]) * scale));
+            bins[bin].count++;
+            bins[bin].Grow(object.boxMin, object.boxMax);
+        }
+
+        float leftArea[kBinCount - 1], rightArea[kBinCount - 1];
+        unsigned int leftCount[kBinCount - 1], rightCount[kBinCount - 1];
+        Bin left, right;
+        for (int i = 0; i < kBinCount - 1; i++) {
+            left.count += bins[i].count;
+            left.Grow(bins[i].boxMin, bins[i].boxMax);
+            leftCount[i] = left.count;
+            leftArea[i] = left.count > 0 ? HalfArea(left.boxMin, left.boxMax) : 0.0f;
+
+            int j = kBinCount - 1 - i;
+            right.count += bins[j].count;
+            right.Grow(bins[j].boxMin, bins[j].boxMax);
+            rightCount[j - 1] = right.count;
+            rightArea[j - 1] = right.count > 0 ? HalfArea(right.boxMin, right.boxMax) : 0.0f;
+        }
+        for (int i = 0; i < kBinCount - 1; i++) {
+            if (leftCount[i] == 0 || rightCount[i] == 0) {
+                continue;
+            }
+            float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i + 1;
+            }
+        }
+    }
+
+    Node &node = nodes[nodeIndex];
+    float leafCost = count * HalfArea(node.boxMin, node.boxMax);
+    float splitCost = kTraversalCost * HalfArea(node.boxMin, node.boxMax) + bestCost;
+    if (count <= kMaxLeafObjects && (bestAxis < 0 || splitCost >= leafCost)) {
+        return false;
+    }
+
+    unsigned int *begin = objectIndices.data() + first, *end = begin + count;
+    unsigned int *middle;
+    if (bestAxis >= 0) {
+        float scale = kBinCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        middle = std::partition(begin, end, [&](unsigned int object) {
+            int bin = std::min(kBinCount - 1, static_cast<int>((centroids[object][bestAxis] - centroidMin[bestAxis]) * scale));
+            return bin < bestSplit;
+        });
+    } else {
+        // every centroid coincides: split the range in half to keep leaves small
+        middle = begin + count / 2;
+    }
+    unsigned int leftCount = static_cast<unsigned int>(middle - begin);
+
+    unsigned int leftIndex = static_cast<unsigned int>(nodes.size());
+    nodes.push_back(Node{glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount});
+    nodes.push_back(Node{glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount});
+    nodes[nodeIndex].leftOrFirst = leftIndex;
+    nodes[nodeIndex].count = 0;
+    UpdateNodeBounds(leftIndex, objects);
+    UpdateNodeBounds(leftIndex + 1, objects);
+    return true;
+}
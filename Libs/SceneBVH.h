@@ -0,0 +1,80 @@
+#ifndef SCENEBVH_H
+#define SCENEBVH_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+/**
+ * Closest object hit by SceneBVH::Raycast.
+ */
+struct RayHit {
+    unsigned int object = 0;
+    float distance = 0.0f;
+};
+
+/**
+ * Bounding volume hierarchy over the world-space boxes of placed objects. Build uses
+ * a binned surface area heuristic; objects that move afterwards only need Refit, which
+ * keeps the tree shape and recomputes the boxes bottom-up. One tree answers frustum
+ * culling, picking rays and camera collision queries.
+ */
+class SceneBVH {
+public:
+    /**
+     * Build the tree over the boxes of objects[i]; query results refer to these indices.
+     */
+    void Build(const std::vector<Bounds> &objects);
+
+    /**
+     * Update the boxes after objects moved. objects must have the same count as in Build.
+     */
+    void Refit(const std::vector<Bounds> &objects);
+
+    /**
+     * @param visible Resized to the object count; set to 1 for objects whose box is not
+     *                entirely behind one of the frustum planes.
+     */
+    void QueryFrustum(const Frustum &frustum, std::vector<unsigned char> &visible) const;
+
+    /**
+     * Find the nearest object box along a ray. Boxes that contain the origin are skipped,
+     * so a ray cast from inside a room picks what is in the room rather than the room.
+     * @param direction Ray direction, need not be normalised; distances are in its units.
+     * @return false if nothing is hit within maxDistance.
+     */
+    bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RayHit &hit) const;
+
+    /**
+     * Collect the objects whose box overlaps a sphere.
+     */
+    void QuerySphere(const glm::vec3 &center, float radius, std::vector<unsigned int> &objects) const;
+
+    size_t GetObjectCount() const { return objectCount; }
+    size_t GetNodeCount() const { return nodes.size(); }
+
+private:
+    // an interior node's children sit at leftOrFirst and leftOrFirst + 1; a leaf holds
+    // objectIndices[leftOrFirst .. leftOrFirst + count)
+    struct Node {
+        glm::vec3 boxMin;
+        unsigned int leftOrFirst;
+        glm::vec3 boxMax;
+        unsigned int count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> objectIndices;
+    // min/max of each object in leaf order, so leaf tests read contiguous memory
+    std::vector<glm::vec3> objectBoxes;
+    size_t objectCount = 0;
+
+    void UpdateNodeBounds(unsigned int nodeIndex, const std::vector<Bounds> &objects);
+    bool SplitNode(unsigned int nodeIndex, const std::vector<Bounds> &objects, const std::vector<glm::vec3> &centroids);
+};
+
+#endif //SCENEBVH_H
@@ -1,5 +1,9 @@
 #include "Shader.h"
 
+#include <algorithm>
+
+ShaderUniformStats Shader::uniformStats;
+
 Shader::Shader()
 {
     shader = 0;
@@ -22,6 +26,12 @@ void Shader::CreateFromFiles (const char* vertexLocation, const char* fragmentLo
     CompileShaders(vertexCode, fragmentCode);
 }
 
+void Shader::CreateComputeFromFile (const char* computeLocation)
+{
+    std::string computeString = ReadFile(computeLocation);
+    CompileComputeShader(computeString.c_str());
+}
+
 std::string Shader::ReadFile(const char* fileLocation)
 {
     std::string content;
@@ -51,6 +61,154 @@ void Shader::UseShader()
     glUseProgram(shader);
 }
 
+GLint Shader::GetUniformLocation(const char* uniformName) const
+{
+    auto found = uniforms.find(uniformName);
+    return found != uniforms.end() ? found->second.location : -1;
+}
+
+void Shader::BindUniformBlock(const char* blockName, GLuint binding)
+{
+    auto found = uniformBlocks.find(blockName);
+    if (found != uniformBlocks.end())
+    {
+        glUniformBlockBinding(shader, found->second, binding);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, GLint value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, &value, sizeof(value)))
+    {
+        glUniform1i(uniform->location, value);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, GLuint value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, &value, sizeof(value)))
+    {
+        glUniform1ui(uniform->location, value);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, GLfloat value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, &value, sizeof(value)))
+    {
+        glUniform1f(uniform->location, value);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, const glm::ivec2& value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    GLint values[2] = {value.x, value.y};
+    if (uniform && Changed(*uniform, values, sizeof(values)))
+    {
+        glUniform2iv(uniform->location, 1, values);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, const glm::vec3& value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, &value[0], sizeof(GLfloat) * 3))
+    {
+        glUniform3fv(uniform->location, 1, &value[0]);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, const glm::mat4& value)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, &value[0][0], sizeof(GLfloat) * 16))
+    {
+        glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &value[0][0]);
+    }
+}
+
+void Shader::SetUniform(const char* uniformName, const GLint* values, GLsizei count)
+{
+    ShaderUniform* uniform = FindUniform(uniformName);
+    if (uniform && Changed(*uniform, values, sizeof(GLint) * count))
+    {
+        glUniform1iv(uniform->location, count, values);
+    }
+}
+
+ShaderUniform* Shader::FindUniform(const char* uniformName)
+{
+    auto found = uniforms.find(uniformName);
+    return found != uniforms.end() ? &found->second : nullptr;
+}
+
+bool Shader::Changed(ShaderUniform& uniform, const void* value, size_t bytes)
+{
+    if (uniform.valueBytes == static_cast<GLsizei>(bytes) && memcmp(uniform.value, value, bytes) == 0)
+    {
+        uniformStats.skipped++;
+        return false;
+    }
+    uniformStats.uploads++;
+    if (bytes <= sizeof(uniform.value))
+    {
+        memcpy(uniform.value, value, bytes);
+        uniform.valueBytes = static_cast<GLsizei>(bytes);
+    }
+    else
+    {
+        // too big to remember, so always uploaded
+        uniform.valueBytes = 0;
+    }
+    return true;
+}
+
+void Shader::Reflect()
+{
+    uniforms.clear();
+    uniformBlocks.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> name(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        ShaderUniform uniform;
+        GLsizei length = 0;
+        glGetActiveUniform(shader, static_cast<GLuint>(i), maxLength, &length, &uniform.size, &uniform.type, name.data());
+        std::string uniformName(name.data(), length);
+        uniform.location = glGetUniformLocation(shader, uniformName.c_str());
+        uniform.valueBytes = 0;
+        // members of uniform blocks have no location and are set through their buffer
+        if (uniform.location < 0)
+        {
+            continue;
+        }
+        // arrays are reported as "name[0]"; answer to the plain name as well
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+        {
+            uniforms[uniformName.substr(0, bracket)] = uniform;
+        }
+        uniforms[uniformName] = uniform;
+    }
+
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(shader, static_cast<GLuint>(i), maxLength, &length, name.data());
+        uniformBlocks[std::string(name.data(), length)] = static_cast<GLuint>(i);
+    }
+}
+
 void Shader::ClearShader()
 {
     if (shader != 0)
@@ -58,6 +216,8 @@ void Shader::ClearShader()
         glDeleteProgram(shader);
         shader = 0;
     }
+    uniforms.clear();
+    uniformBlocks.clear();
 }
 
 void Shader::CreateFromString (const char* vertexCode, const char* fragmentCode)
@@ -79,6 +239,29 @@ void Shader::CompileShaders(const char* vertexCode, const char* fragmentCode)
     AddShader(shader, vertexCode, GL_VERTEX_SHADER);
     AddShader(shader, fragmentCode, GL_FRAGMENT_SHADER);
 
+    LinkProgram();
+}
+
+void Shader::CompileComputeShader(const char* computeCode)
+{
+    shader = glCreateProgram();
+
+    if (!shader)
+    {
+        printf("Error creating compute program!\n");
+        return;
+    }
+
+    AddShader(shader, computeCode, GL_COMPUTE_SHADER);
+
+    if (!LinkProgram())
+    {
+        ClearShader();
+    }
+}
+
+bool Shader::LinkProgram()
+{
     GLint result = 0;
     GLchar elog[1024] = { 0 };
 
@@ -89,9 +272,12 @@ void Shader::CompileShaders(const char* vertexCode, const char* fragmentCode)
     {
         glGetProgramInfoLog(shader, sizeof(elog), NULL, elog);
         printf("Error linking program: '%s'\n", elog);
-        return;
+        return false;
     }
 
+    // look every uniform up once here rather than on each use
+    Reflect();
+
     glValidateProgram(shader);
     glGetProgramiv(shader, GL_VALIDATE_STATUS, &result);
 
@@ -99,8 +285,10 @@ void Shader::CompileShaders(const char* vertexCode, const char* fragmentCode)
     {
         glGetProgramInfoLog(shader, sizeof(elog), NULL, elog);
         printf("Error validating program: '%s'\n", elog);
-        return;
+        return false;
     }
+
+    return true;
 }
 
 void Shader::AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType)
@@ -6,8 +6,30 @@
 #include <stdio.h>
 #include <string>
 #include <string.h>
+#include <map>
+#include <vector>
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// an active uniform found by reflection after linking
+struct ShaderUniform
+{
+    GLint location;
+    GLenum type;
+    // array length, 1 for plain uniforms
+    GLint size;
+    // last value a typed setter uploaded, so setting it again can be skipped
+    GLsizei valueBytes;
+    unsigned char value[64];
+};
+
+// uniform uploads made and skipped by the typed setters, over every program
+struct ShaderUniformStats
+{
+    unsigned int uploads = 0;
+    unsigned int skipped = 0;
+};
 
 class Shader
 {
@@ -17,16 +39,47 @@ class Shader
 
         void CreateFromString (const char* vertexCode, const char* fragmentCode);
         void CreateFromFiles (const char* vertexLocation, const char* fragmentLocation);
+        // compute-only program, needs an OpenGL 4.3 context
+        void CreateComputeFromFile (const char* computeLocation);
         std::string ReadFile(const char* fileLocation);
 
         void UseShader();
+        bool IsValid() {return shader != 0;}
         void ClearShader();
 
-        GLuint GetUniformLocation(const char* uniformName) {return glGetUniformLocation(shader, uniformName);}
+        // from the table reflected after linking; -1 if the program has no such active uniform
+        GLint GetUniformLocation(const char* uniformName) const;
+        // connect a uniform block to a GL_UNIFORM_BUFFER binding point; no-op if the program lacks it
+        void BindUniformBlock(const char* blockName, GLuint binding);
+
+        // set a uniform of the bound program, skipping the GL call if it already holds value
+        void SetUniform(const char* uniformName, GLint value);
+        void SetUniform(const char* uniformName, GLuint value);
+        void SetUniform(const char* uniformName, GLfloat value);
+        void SetUniform(const char* uniformName, const glm::ivec2& value);
+        void SetUniform(const char* uniformName, const glm::vec3& value);
+        void SetUniform(const char* uniformName, const glm::mat4& value);
+        void SetUniform(const char* uniformName, const GLint* values, GLsizei count);
+
+        static const ShaderUniformStats& GetUniformStats() {return uniformStats;}
+        static void ResetUniformStats() {uniformStats = ShaderUniformStats();}
 
     private:
         GLuint shader;
+        // std::less<> finds names by const char* without building a std::string
+        std::map<std::string, ShaderUniform, std::less<>> uniforms;
+        std::map<std::string, GLuint, std::less<>> uniformBlocks;
+
+        static ShaderUniformStats uniformStats;
+
+        // fill uniforms and uniformBlocks from the linked program
+        void Reflect();
+        ShaderUniform* FindUniform(const char* uniformName);
+        // true if value differs from the uniform's last one, which it then becomes
+        bool Changed(ShaderUniform& uniform, const void* value, size_t bytes);
         void CompileShaders(const char* vertexCode, const char* fragmentCode);
+        void CompileComputeShader(const char* computeCode);
+        bool LinkProgram();
         void AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
 
 };
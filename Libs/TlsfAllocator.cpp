@@ -0,0 +1,224 @@
+#include "TlsfAllocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// index of the lowest and highest set bit; x must not be zero
+static uint32_t LowestBit(uint32_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#endif
+}
+
+static uint32_t HighestBit(uint32_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, x);
+    return index;
+#else
+    return 31u - static_cast<uint32_t>(__builtin_clz(x));
+#endif
+}
+
+TlsfAllocator::TlsfAllocator(uint32_t capacity) {
+    this->capacity = 0;
+    used = 0;
+    freeBlockCount = 0;
+    lastBlock = NO_BLOCK;
+    firstLevelBitmap = 0;
+    for (uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; firstLevel++) {
+        secondLevelBitmaps[firstLevel] = 0;
+        for (uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; secondLevel++) {
+            freeLists[firstLevel][secondLevel] = NO_BLOCK;
+        }
+    }
+    Grow(capacity);
+}
+
+void TlsfAllocator::Mapping(uint32_t size, uint32_t &firstLevel, uint32_t &secondLevel) {
+    if (size < SECOND_LEVEL_COUNT) {
+        // small sizes get one exact class each
+        firstLevel = 0;
+        secondLevel = size;
+        return;
+    }
+    uint32_t log = HighestBit(size);
+    firstLevel = log - SECOND_LEVEL_BITS + 1;
+    secondLevel = (size >> (log - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+}
+
+uint32_t TlsfAllocator::Allocate(uint32_t size) {
+    if (size == 0) {
+        size = 1;
+    }
+
+    // round up to the next class boundary, so any block in the class found is large enough
+    uint32_t searchSize = size;
+    if (size >= SECOND_LEVEL_COUNT) {
+        uint32_t step = (1u << (HighestBit(size) - SECOND_LEVEL_BITS)) - 1;
+        if (size > 0xFFFFFFFFu - step) {
+            return INVALID_OFFSET;
+        }
+        searchSize += step;
+    }
+    uint32_t firstLevel, secondLevel;
+    Mapping(searchSize, firstLevel, secondLevel);
+
+    uint32_t secondLevelMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0) {
+        uint32_t firstLevelMap = firstLevel + 1 < FIRST_LEVEL_COUNT ? firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0) {
+            return INVALID_OFFSET;
+        }
+        firstLevel = LowestBit(firstLevelMap);
+        secondLevelMap = secondLevelBitmaps[firstLevel];
+    }
+    uint32_t block = freeLists[firstLevel][LowestBit(secondLevelMap)];
+    RemoveFree(block);
+
+    // hand back what is left over
+    if (blocks[block].size > size) {
+        uint32_t rest = NewBlock(blocks[block].offset + size, blocks[block].size - size);
+        uint32_t next = blocks[block].nextPhysical;
+        blocks[rest].previousPhysical = block;
+        blocks[rest].nextPhysical = next;
+        if (next != NO_BLOCK) {
+            blocks[next].previousPhysical = rest;
+        }
+        blocks[block].nextPhysical = rest;
+        blocks[block].size = size;
+        if (lastBlock == block) {
+            lastBlock = rest;
+        }
+        InsertFree(rest);
+    }
+
+    used += size;
+    allocations[blocks[block].offset] = block;
+    return blocks[block].offset;
+}
+
+void TlsfAllocator::Free(uint32_t offset) {
+    auto allocation = allocations.find(offset);
+    if (allocation == allocations.end()) {
+        return;
+    }
+    uint32_t block = allocation->second;
+    allocations.erase(allocation);
+    used -= blocks[block].size;
+
+    uint32_t previous = blocks[block].previousPhysical;
+    if (previous != NO_BLOCK && blocks[previous].free) {
+        RemoveFree(previous);
+        MergeNext(previous, block);
+        block = previous;
+    }
+    uint32_t next = blocks[block].nextPhysical;
+    if (next != NO_BLOCK && blocks[next].free) {
+        RemoveFree(next);
+        MergeNext(block, next);
+    }
+    InsertFree(block);
+}
+
+void TlsfAllocator::Grow(uint32_t newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+    uint32_t extra = newCapacity - capacity;
+    if (lastBlock != NO_BLOCK && blocks[lastBlock].free) {
+        RemoveFree(lastBlock);
+        blocks[lastBlock].size += extra;
+        InsertFree(lastBlock);
+    } else {
+        uint32_t block = NewBlock(capacity, extra);
+        blocks[block].previousPhysical = lastBlock;
+        if (lastBlock != NO_BLOCK) {
+            blocks[lastBlock].nextPhysical = block;
+        }
+        lastBlock = block;
+        InsertFree(block);
+    }
+    capacity = newCapacity;
+}
+
+uint32_t TlsfAllocator::GetLargestFreeBlock() const {
+    if (firstLevelBitmap == 0) {
+        return 0;
+    }
+    uint32_t firstLevel = HighestBit(firstLevelBitmap);
+    uint32_t secondLevel = HighestBit(secondLevelBitmaps[firstLevel]);
+    uint32_t largest = 0;
+    for (uint32_t block = freeLists[firstLevel][secondLevel]; block != NO_BLOCK; block = blocks[block].nextFree) {
+        largest = blocks[block].size > largest ? blocks[block].size : largest;
+    }
+    return largest;
+}
+
+uint32_t TlsfAllocator::NewBlock(uint32_t offset, uint32_t size) {
+    Block block = {offset, size, NO_BLOCK, NO_BLOCK, NO_BLOCK, NO_BLOCK, false};
+    if (!unusedBlocks.empty()) {
+        uint32_t index = unusedBlocks.back();
+        unusedBlocks.pop_back();
+        blocks[index] = block;
+        return index;
+    }
+    blocks.push_back(block);
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void TlsfAllocator::InsertFree(uint32_t block) {
+    uint32_t firstLevel, secondLevel;
+    Mapping(blocks[block].size, firstLevel, secondLevel);
+    uint32_t &head = freeLists[firstLevel][secondLevel];
+    blocks[block].free = true;
+    blocks[block].previousFree = NO_BLOCK;
+    blocks[block].nextFree = head;
+    if (head != NO_BLOCK) {
+        blocks[head].previousFree = block;
+    }
+    head = block;
+    firstLevelBitmap |= 1u << firstLevel;
+    secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    freeBlockCount++;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t block) {
+    uint32_t firstLevel, secondLevel;
+    Mapping(blocks[block].size, firstLevel, secondLevel);
+    uint32_t previous = blocks[block].previousFree, next = blocks[block].nextFree;
+    if (previous != NO_BLOCK) {
+        blocks[previous].nextFree = next;
+    } else {
+        freeLists[firstLevel][secondLevel] = next;
+    }
+    if (next != NO_BLOCK) {
+        blocks[next].previousFree = previous;
+    }
+    if (freeLists[firstLevel][secondLevel] == NO_BLOCK) {
+        secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (secondLevelBitmaps[firstLevel] == 0) {
+            firstLevelBitmap &= ~(1u << firstLevel);
+        }
+    }
+    blocks[block].free = false;
+    freeBlockCount--;
+}
+
+void TlsfAllocator::MergeNext(uint32_t block, uint32_t next) {
+    blocks[block].size += blocks[next].size;
+    uint32_t after = blocks[next].nextPhysical;
+    blocks[block].nextPhysical = after;
+    if (after != NO_BLOCK) {
+        blocks[after].previousPhysical = block;
+    }
+    if (lastBlock == next) {
+        lastBlock = block;
+    }
+    unusedBlocks.push_back(next);
+}
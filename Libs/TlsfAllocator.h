@@ -0,0 +1,79 @@
+#ifndef TLSFALLOCATOR_H
+#define TLSFALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Two-level segregated fit allocator over a range of abstract units, such as the vertices
+ * of a GPU buffer. It only keeps the books, so the memory itself can live anywhere.
+ * Free blocks are binned by size into power-of-two classes split into 16 linear steps,
+ * and two bitmaps find a block at least as large as a request in constant time. Freed
+ * blocks merge with free neighbours straight away, so space returns to large runs.
+ */
+class TlsfAllocator {
+public:
+    static const uint32_t INVALID_OFFSET = 0xFFFFFFFFu;
+
+    explicit TlsfAllocator(uint32_t capacity = 0);
+
+    /**
+     * @return the offset of size free units, or INVALID_OFFSET if no free block is large enough.
+     */
+    uint32_t Allocate(uint32_t size);
+
+    /**
+     * Return an allocation made by Allocate.
+     */
+    void Free(uint32_t offset);
+
+    /**
+     * Extend the range to newCapacity units; existing allocations keep their offsets.
+     */
+    void Grow(uint32_t newCapacity);
+
+    uint32_t GetCapacity() const { return capacity; }
+    uint32_t GetUsed() const { return used; }
+    size_t GetAllocationCount() const { return allocations.size(); }
+    size_t GetFreeBlockCount() const { return freeBlockCount; }
+    // the largest allocation that can currently succeed
+    uint32_t GetLargestFreeBlock() const;
+
+private:
+    static const uint32_t SECOND_LEVEL_BITS = 4;
+    static const uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+    static const uint32_t FIRST_LEVEL_COUNT = 32 - SECOND_LEVEL_BITS + 1;
+    static const uint32_t NO_BLOCK = 0xFFFFFFFFu;
+
+    struct Block {
+        uint32_t offset, size;
+        // neighbours in address order, and in the block's free list while it is free
+        uint32_t previousPhysical, nextPhysical;
+        uint32_t previousFree, nextFree;
+        bool free;
+    };
+
+    uint32_t capacity;
+    uint32_t used;
+    size_t freeBlockCount;
+    // the block ending at capacity, which Grow extends
+    uint32_t lastBlock;
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    std::unordered_map<uint32_t, uint32_t> allocations;
+    uint32_t firstLevelBitmap;
+    uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT];
+    uint32_t freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+
+    uint32_t NewBlock(uint32_t offset, uint32_t size);
+    void InsertFree(uint32_t block);
+    void RemoveFree(uint32_t block);
+    // absorb next, which must follow block in address order, into block
+    void MergeNext(uint32_t block, uint32_t next);
+
+    static void Mapping(uint32_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+};
+
+#endif //TLSFALLOCATOR_H
@@ -0,0 +1,75 @@
+#ifndef VERTEXINDEXTABLE_H
+#define VERTEXINDEXTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Flat open-addressing hash table that maps an OBJ face corner, i.e. the
+ * (vIndex, vtIndex, vnIndex) triple, to its slot in the deduplicated vertex arrays.
+ * The table is sized once up front from the number of face corners, so it never
+ * rehashes and never allocates per lookup.
+ */
+class VertexIndexTable {
+public:
+    static const unsigned int EMPTY = 0xFFFFFFFFu;
+
+    /**
+     * @param cornerCount Upper bound on the number of distinct keys (3 * face count).
+     */
+    explicit VertexIndexTable(size_t cornerCount) {
+        // keep the load factor at or below 2/3 even if every corner is unique
+        size_t capacity = 16;
+        while (capacity < cornerCount + cornerCount / 2 + 1) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, Slot{0, 0, 0, EMPTY});
+        mask = capacity - 1;
+    }
+
+    /**
+     * Look up a corner and insert it if it has not been seen yet.
+     * @param v Position index.
+     * @param vt Texture coordinate index.
+     * @param vn Normal index.
+     * @param newIndex The index to store when the key is missing.
+     * @param inserted Set to true when the key was inserted by this call.
+     * @return The index stored for the key.
+     */
+    unsigned int findOrInsert(int v, int vt, int vn, unsigned int newIndex, bool &inserted) {
+        size_t i = hash(v, vt, vn) & mask;
+        while (true) {
+            Slot &slot = slots[i];
+            if (slot.index == EMPTY) {
+                slot = Slot{v, vt, vn, newIndex};
+                inserted = true;
+                return newIndex;
+            }
+            if (slot.v == v && slot.vt == vt && slot.vn == vn) {
+                inserted = false;
+                return slot.index;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+
+private:
+    struct Slot {
+        int v, vt, vn;
+        unsigned int index;
+    };
+
+    static size_t hash(int v, int vt, int vn) {
+        uint64_t h = static_cast<uint32_t>(v) * 0x9E3779B97F4A7C15ull;
+        h ^= static_cast<uint32_t>(vt) * 0xC2B2AE3D27D4EB4Full;
+        h ^= static_cast<uint32_t>(vn) * 0x165667B19E3779F9ull;
+        h ^= h >> 29;
+        return static_cast<size_t>(h);
+    }
+
+    std::vector<Slot> slots;
+    size_t mask;
+};
+
+#endif //VERTEXINDEXTABLE_H
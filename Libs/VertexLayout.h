@@ -0,0 +1,138 @@
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "MeshData.h"
+
+/**
+ * One vertex attribute of an interleaved vertex: where it binds and how GL reads it.
+ */
+struct VertexAttribute {
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+/**
+ * Maps a C++ member type to the component count and GL type used to fetch it.
+ */
+template <typename T>
+struct AttributeTraits;
+
+template <>
+struct AttributeTraits<float> {
+    static constexpr GLint components = 1;
+    static constexpr GLenum type = GL_FLOAT;
+};
+
+template <>
+struct AttributeTraits<glm::vec2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_FLOAT;
+};
+
+template <>
+struct AttributeTraits<glm::vec3> {
+    static constexpr GLint components = 3;
+    static constexpr GLenum type = GL_FLOAT;
+};
+
+template <>
+struct AttributeTraits<glm::vec4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_FLOAT;
+};
+
+template <>
+struct AttributeTraits<Unorm16x4> {
+    static constexpr GLint components = 4;
+    static constexpr GLenum type = GL_UNSIGNED_SHORT;
+};
+
+template <>
+struct AttributeTraits<Snorm16x2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_SHORT;
+};
+
+template <>
+struct AttributeTraits<Half2> {
+    static constexpr GLint components = 2;
+    static constexpr GLenum type = GL_HALF_FLOAT;
+};
+
+/**
+ * Maps an index type to the GL type passed to glDrawElements.
+ */
+template <typename Index>
+struct IndexTraits;
+
+template <>
+struct IndexTraits<unsigned int> {
+    static constexpr GLenum type = GL_UNSIGNED_INT;
+};
+
+template <>
+struct IndexTraits<uint16_t> {
+    static constexpr GLenum type = GL_UNSIGNED_SHORT;
+};
+
+/**
+ * Describe a member of an interleaved vertex struct as an attribute at a shader location.
+ */
+#define VERTEX_ATTRIBUTE(Vertex, member, location, normalized) \
+    VertexAttribute{location, AttributeTraits<decltype(Vertex::member)>::components, \
+                    AttributeTraits<decltype(Vertex::member)>::type, normalized, offsetof(Vertex, member)}
+
+/**
+ * Compile-time attribute list of a vertex struct. Specialise it for each vertex
+ * format; Mesh uses it to size the interleaved buffer and to set up the VAO.
+ */
+template <typename Vertex>
+struct VertexLayout;
+
+template <>
+struct VertexLayout<VertexPT> {
+    static constexpr VertexAttribute attributes[] = {
+        VERTEX_ATTRIBUTE(VertexPT, position, 0, GL_FALSE),
+        VERTEX_ATTRIBUTE(VertexPT, texCoord, 1, GL_FALSE),
+    };
+};
+
+template <>
+struct VertexLayout<VertexPTN> {
+    static constexpr VertexAttribute attributes[] = {
+        VERTEX_ATTRIBUTE(VertexPTN, position, 0, GL_FALSE),
+        VERTEX_ATTRIBUTE(VertexPTN, texCoord, 1, GL_FALSE),
+        VERTEX_ATTRIBUTE(VertexPTN, normal, 2, GL_FALSE),
+    };
+};
+
+template <>
+struct VertexLayout<VertexCompact> {
+    static constexpr VertexAttribute attributes[] = {
+        VERTEX_ATTRIBUTE(VertexCompact, position, 0, GL_TRUE),
+        VERTEX_ATTRIBUTE(VertexCompact, texCoord, 1, GL_FALSE),
+        VERTEX_ATTRIBUTE(VertexCompact, normal, 2, GL_TRUE),
+    };
+};
+
+/**
+ * Point the attributes of the bound VAO at the bound GL_ARRAY_BUFFER, interleaved as Vertex.
+ */
+template <typename Vertex>
+void ApplyVertexLayout() {
+    for (const VertexAttribute &attribute : VertexLayout<Vertex>::attributes) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized,
+                              sizeof(Vertex), (void *)attribute.offset);
+    }
+}
+
+#endif //VERTEXLAYOUT_H
@@ -54,6 +54,17 @@ int Window::initialise()
 
     mainWindow = glfwCreateWindow(width, height, (this->title) ? this->title : "Test Window", NULL, NULL);
 
+    //Newer contexts are optional extras, fall back to 3.3
+    if (!mainWindow && (glfwMajorVersion > 3 || (glfwMajorVersion == 3 && glfwMinorVersion > 3)))
+    {
+        printf("OpenGL %d.%d context unavailable, falling back to 3.3\n", glfwMajorVersion, glfwMinorVersion);
+        glfwMajorVersion = 3;
+        glfwMinorVersion = 3;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glfwMajorVersion);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glfwMinorVersion);
+        mainWindow = glfwCreateWindow(width, height, (this->title) ? this->title : "Test Window", NULL, NULL);
+    }
+
     if (!mainWindow)
     {
         printf("GLFW window creation failed!");
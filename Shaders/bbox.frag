@@ -0,0 +1,9 @@
+#version 330
+
+// only the depth test matters; colour writes are masked off while drawing boxes
+out vec4 colour;
+
+void main()
+{
+    colour = vec4(1.0);
+}
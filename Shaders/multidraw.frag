@@ -0,0 +1,24 @@
+#version 430
+
+out vec4 colour;
+in vec2 TexCoord;
+
+// matches FrameBlock, bound at FrameUniforms::FRAME_BINDING
+layout (std140, binding = 0) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightColour;
+    float time;
+};
+
+// one texture per call: GLSL only allows a dynamically uniform index into a sampler array,
+// and gl_DrawIDARB is not uniform across the sub-draws of a multi-draw
+uniform sampler2D texture2D;
+
+void main()
+{
+    float ambientStrength = 1.0f;
+    vec3 ambient = ambientStrength * lightColour.rgb;
+    colour = texture(texture2D, TexCoord) * vec4(ambient, 1.0);
+}
@@ -0,0 +1,55 @@
+#version 430
+#extension GL_ARB_shader_draw_parameters : require
+
+// shader.vert for MultiDrawIndirect: each draw's model matrix and mesh parameters come
+// from the Draws buffer instead of uniforms
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+// matches MultiDrawIndirect::DrawData
+struct DrawData {
+    mat4 model;
+    vec4 positionScale;
+    vec4 positionOffset;
+    uint octahedralNormals;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout (std430, binding = 0) readonly buffer Draws { DrawData draws[]; };
+
+// matches FrameBlock, bound at FrameUniforms::FRAME_BINDING
+layout (std140, binding = 0) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightColour;
+    float time;
+};
+// index in draws of this call's first draw
+uniform uint drawOffset;
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    DrawData draw = draws[drawOffset + uint(gl_DrawIDARB)];
+    vec3 pos = aPos * draw.positionScale.xyz + draw.positionOffset.xyz;
+    vec3 normal = draw.octahedralNormals != 0u ? octahedralDecode(aNormal.xy) : aNormal;
+
+    gl_Position = viewProjection * draw.model * vec4(pos, 1.0);
+    TexCoord = aTexCoord;
+    Normal = mat3(draw.model) * normal;
+}
@@ -4,13 +4,20 @@ out vec4 colour;
 in vec4 vCol;
 in vec2 TexCoord;
 
-uniform vec3 lightColour;
+// written once per frame, matches FrameBlock
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightColour;
+    float time;
+};
 
 uniform sampler2D texture2D;
 
 void main()
 {
     float ambientStrength = 1.0f;
-    vec3 ambient = ambientStrength * lightColour;
+    vec3 ambient = ambientStrength * lightColour.rgb;
     colour = texture(texture2D, TexCoord) * vec4(ambient, 1.0);
 }
\ No newline at end of file
@@ -1,20 +1,52 @@
 #version 330
 
-layout (location = 0) in vec3 pos;
+layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+// world placement of the instance, applied after model; identity when not instanced
+layout (location = 3) in mat4 aInstance;
 
-// create a uniform (global) variable for the model matrix
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// written once per frame, matches FrameBlock
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightColour;
+    float time;
+};
+
+// this object's slice of the frame's buffer, matches DrawBlock
+layout (std140) uniform Draw {
+    mat4 model;
+    // compact meshes store positions as unorm16 within the mesh bounds
+    // and normals octahedral-encoded in aNormal.xy
+    vec4 positionScale;
+    vec4 positionOffset;
+    int octahedralNormals;
+};
 
 out vec4 vCol;
 out vec2 TexCoord;
+out vec3 Normal;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
+    vec3 pos = aPos * positionScale.xyz + positionOffset.xyz;
+    vec3 normal = octahedralNormals != 0 ? octahedralDecode(aNormal.xy) : aNormal;
+
     // gl_Position = vec4(0.4 * pos.x, 0.4 * pos.y, pos.z, 1.0);
-    gl_Position = projection * view * model * vec4(pos, 1.0);
+    mat4 world = aInstance * model;
+    gl_Position = viewProjection * world * vec4(pos, 1.0);
     vCol = vec4(clamp(pos, 0.0f, 1.0f), 1.0f);
     TexCoord = aTexCoord;
+    Normal = mat3(world) * normal;
 }
\ No newline at end of file
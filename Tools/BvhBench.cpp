@@ -0,0 +1,158 @@
+// BvhBench.cpp
+// Build, refit and query throughput of SceneBVH on a synthetic scene, checked
+// against brute-force answers.
+// Usage: bvh-bench [--objects N] [--queries Q] [--seed S]
+#include "../Libs/SceneBVH.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/**
+ * Objects scattered through a cube of side worldSize, sized like the models in the scene.
+ */
+static std::vector<Bounds> MakeScene(size_t count, float worldSize, std::mt19937 &random) {
+    std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<float> size(0.2f, 3.0f);
+    std::vector<Bounds> objects(count);
+    for (Bounds &object : objects) {
+        glm::vec3 center(position(random), position(random) * 0.1f, position(random));
+        glm::vec3 half(size(random), size(random), size(random));
+        object.boxMin = center - half;
+        object.boxMax = center + half;
+        object.sphereCenter = center;
+        object.sphereRadius = glm::length(half);
+    }
+    return objects;
+}
+
+int main(int argc, char **argv) {
+    size_t objectCount = 100000;
+    int queryCount = 1000;
+    unsigned int seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            objectCount = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+            queryCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::cerr << "Usage: bvh-bench [--objects N] [--queries Q] [--seed S]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937 random(seed);
+    const float worldSize = 2000.0f;
+    std::vector<Bounds> objects = MakeScene(objectCount, worldSize, random);
+
+    SceneBVH bvh;
+    auto buildStart = std::chrono::steady_clock::now();
+    bvh.Build(objects);
+    auto buildEnd = std::chrono::steady_clock::now();
+    std::cout << objectCount << " objects, " << bvh.GetNodeCount() << " nodes" << std::endl;
+    std::cout << "  build: " << ElapsedMs(buildStart, buildEnd) << " ms" << std::endl;
+
+    // bounce a tenth of the objects like TheCat's jump, then refit
+    std::uniform_real_distribution<float> jump(-8.0f, 8.0f);
+    for (size_t i = 0; i < objectCount; i += 10) {
+        glm::vec3 offset(0.0f, jump(random), 0.0f);
+        objects[i].boxMin += offset;
+        objects[i].boxMax += offset;
+    }
+    auto refitStart = std::chrono::steady_clock::now();
+    bvh.Refit(objects);
+    auto refitEnd = std::chrono::steady_clock::now();
+    std::cout << "  refit: " << ElapsedMs(refitStart, refitEnd) << " ms" << std::endl;
+
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> place(-worldSize * 0.5f, worldSize * 0.5f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+
+    // frustum: BVH against testing every box with CullBoxes
+    BoxList boxes;
+    for (const Bounds &object : objects) {
+        boxes.Add(object.boxMin, object.boxMax);
+    }
+    std::vector<Frustum> frustums;
+    for (int q = 0; q < queryCount; q++) {
+        glm::vec3 eye(place(random), 0.0f, place(random));
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random) * 0.2f, unit(random)) + glm::vec3(1e-3f));
+        frustums.emplace_back(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    std::vector<unsigned char> visible, expected;
+    size_t visibleTotal = 0, frustumMismatches = 0;
+    double bvhMs = 0.0, bruteMs = 0.0;
+    for (const Frustum &frustum : frustums) {
+        auto start = std::chrono::steady_clock::now();
+        bvh.QueryFrustum(frustum, visible);
+        auto middle = std::chrono::steady_clock::now();
+        CullBoxes(frustum, boxes, expected);
+        auto end = std::chrono::steady_clock::now();
+        bvhMs += ElapsedMs(start, middle);
+        bruteMs += ElapsedMs(middle, end);
+        for (size_t i = 0; i < objectCount; i++) {
+            visibleTotal += visible[i];
+            frustumMismatches += visible[i] != expected[i];
+        }
+    }
+    std::cout << "  frustum: " << queryCount / (bvhMs / 1000.0) << " queries/s (brute force "
+              << queryCount / (bruteMs / 1000.0) << "), " << visibleTotal / double(queryCount)
+              << " visible per query, " << frustumMismatches << " mismatches" << std::endl;
+
+    // rays: nearest box along random rays
+    size_t rayCount = static_cast<size_t>(queryCount) * 100, rayHits = 0, rayMismatches = 0;
+    double rayMs = 0.0;
+    for (size_t q = 0; q < rayCount; q++) {
+        glm::vec3 origin(place(random), unit(random) * 20.0f, place(random));
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random) * 0.1f, unit(random)) + glm::vec3(1e-3f));
+        RayHit hit;
+        auto start = std::chrono::steady_clock::now();
+        bool found = bvh.Raycast(origin, direction, 500.0f, hit);
+        rayMs += ElapsedMs(start, std::chrono::steady_clock::now());
+        rayHits += found;
+        // spot-check against every box
+        if (q % 100 == 0) {
+            float best = 500.0f;
+            bool bruteFound = false;
+            for (const Bounds &object : objects) {
+                glm::vec3 t0 = (object.boxMin - origin) / direction, t1 = (object.boxMax - origin) / direction;
+                glm::vec3 nearT = glm::min(t0, t1), farT = glm::max(t0, t1);
+                float entry = std::max(nearT.x, std::max(nearT.y, nearT.z));
+                float exit = std::min(farT.x, std::min(farT.y, farT.z));
+                if (entry <= exit && entry >= 0.0f && entry <= best) {
+                    best = entry;
+                    bruteFound = true;
+                }
+            }
+            rayMismatches += bruteFound != found || (found && std::abs(best - hit.distance) > 1e-3f);
+        }
+    }
+    std::cout << "  rays: " << rayCount / (rayMs / 1000.0) << " rays/s, " << 100.0 * rayHits / rayCount
+              << "% hit, " << rayMismatches << " mismatches in " << rayCount / 100 << " checked" << std::endl;
+
+    // spheres: camera-collision sized overlap queries
+    std::vector<unsigned int> overlapping;
+    size_t sphereCount = static_cast<size_t>(queryCount) * 100, overlapTotal = 0;
+    double sphereMs = 0.0;
+    for (size_t q = 0; q < sphereCount; q++) {
+        glm::vec3 center(place(random), unit(random) * 20.0f, place(random));
+        auto start = std::chrono::steady_clock::now();
+        bvh.QuerySphere(center, 5.0f, overlapping);
+        sphereMs += ElapsedMs(start, std::chrono::steady_clock::now());
+        overlapTotal += overlapping.size();
+    }
+    std::cout << "  spheres: " << sphereCount / (sphereMs / 1000.0) << " queries/s, "
+              << overlapTotal / double(sphereCount) << " objects per query" << std::endl;
+    return frustumMismatches == 0 && rayMismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// ObjBench.cpp
+// Command-line report of OBJ parse throughput and thread scaling, plus the
+// vertex cache and overdraw effect of the mesh optimisation stages and the
+// resulting meshlet fill.
+// Usage: obj-bench [--threads N] [--repeat R] [--overdraw-threshold T] file.obj...
+#include "../Libs/MappedFile.h"
+#include "../Libs/MeshOptimizer.h"
+#include "../Libs/Meshlet.h"
+#include "../Libs/ObjParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+/**
+ * Parse a mapped file with the given thread count, returning the best time of several runs.
+ */
+static double TimeParse(const MappedFile &file, unsigned int threads, int repeat, ObjData &result) {
+    double best = 1e30;
+    for (int r = 0; r < repeat; r++) {
+        ObjData data;
+        auto start = std::chrono::steady_clock::now();
+        ParseOBJBufferParallel(file.GetData(), file.GetData() + file.GetSize(), data, threads);
+        best = std::min(best, ElapsedMs(start, std::chrono::steady_clock::now()));
+        if (r == 0) {
+            result = std::move(data);
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    int repeat = 5;
+    float overdrawThreshold = 1.05f;
+    std::vector<const char *> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            maxThreads = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--overdraw-threshold") == 0 && i + 1 < argc) {
+            overdrawThreshold = static_cast<float>(atof(argv[++i]));
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        std::cout << "Usage: obj-bench [--threads N] [--repeat R] [--overdraw-threshold T] file.obj..." << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    for (const char *path : paths) {
+        MappedFile file;
+        if (!file.Open(path)) {
+            std::cout << "Failed to open " << path << std::endl;
+            continue;
+        }
+        double megabytes = file.GetSize() / (1024.0 * 1024.0);
+        std::cout << "========================================" << std::endl;
+        std::cout << path << " (" << megabytes << " MB)" << std::endl;
+
+        double baseline = 0.0;
+        ObjData reference;
+        for (unsigned int threads = 1; threads <= maxThreads; threads++) {
+            ObjData data;
+            double ms = TimeParse(file, threads, repeat, data);
+            if (threads == 1) {
+                baseline = ms;
+                reference = std::move(data);
+            } else if (data.faces.size() != reference.faces.size() ||
+                       data.positions.size() != reference.positions.size()) {
+                std::cout << "  mismatch at " << threads << " threads!" << std::endl;
+            }
+            std::cout << "  threads " << std::setw(2) << threads << ": " << std::setw(8) << ms << " ms  "
+                      << std::setw(8) << megabytes / (ms / 1000.0) << " MB/s  speedup "
+                      << baseline / ms << "x" << std::endl;
+        }
+
+        MeshData mesh;
+        auto dedupStart = std::chrono::steady_clock::now();
+        BuildMeshData(reference, mesh);
+        std::cout << "  dedup: " << ElapsedMs(dedupStart, std::chrono::steady_clock::now()) << " ms, "
+                  << mesh.vertices.size() << " unique vertices, " << mesh.indices.size() << " indices" << std::endl;
+
+        VertexCacheStats rawCache = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        OverdrawStats rawOverdraw = AnalyzeOverdraw(mesh.vertices, mesh.indices);
+        OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+        VertexCacheStats cacheOptimized = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        OverdrawStats cacheOverdraw = AnalyzeOverdraw(mesh.vertices, mesh.indices);
+        OptimizeOverdraw(mesh.indices, mesh.vertices, overdrawThreshold);
+        VertexCacheStats overdrawCache = AnalyzeVertexCache(mesh.indices, mesh.vertices.size());
+        OverdrawStats overdrawOptimized = AnalyzeOverdraw(mesh.vertices, mesh.indices);
+
+        std::cout << "  file order:      ACMR " << rawCache.acmr << "  ATVR " << rawCache.atvr
+                  << "  overdraw " << rawOverdraw.overdraw << std::endl;
+        std::cout << "  vertex cache:    ACMR " << cacheOptimized.acmr << "  ATVR " << cacheOptimized.atvr
+                  << "  overdraw " << cacheOverdraw.overdraw << std::endl;
+        std::cout << "  + overdraw " << overdrawThreshold << ": ACMR " << overdrawCache.acmr << "  ATVR "
+                  << overdrawCache.atvr << "  overdraw " << overdrawOptimized.overdraw << std::endl;
+
+        OptimizeVertexFetch(mesh);
+        MeshletStats meshlets = AnalyzeMeshlets(BuildMeshlets(MakeMeshView(mesh)));
+        std::cout << "  meshlets:        " << meshlets.meshletCount << " clusters, "
+                  << meshlets.averageVertices << " vertices (" << meshlets.vertexFill * 100.0f << "%), "
+                  << meshlets.averageTriangles << " triangles (" << meshlets.triangleFill * 100.0f << "%)" << std::endl;
+    }
+    return 0;
+}
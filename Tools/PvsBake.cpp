@@ -0,0 +1,457 @@
+// PvsBake.cpp
+// Bakes a potentially visible set for a static scene. The scene is voxelised, every empty
+// voxel becomes a camera cell, and random rays sampled from inside each cell record which
+// objects it can see. The result is written as a PotentiallyVisibleSet bitset file.
+// Usage: pvs-bake [--cell-size S] [--rays R] [--threads N] [--dilate D] [--output file.pvs] scene
+//
+// The scene file lists the models in the viewer's load order, placed as in the viewer:
+//   model <path.obj> <x> <y> <z> <scale> [rotate <x|y|z> <degrees>]...
+// with the rotations applied in the order getModelMatrix applies them.
+#include "../Libs/ObjParser.h"
+#include "../Libs/PotentiallyVisibleSet.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// beyond this many cells per axis the bake takes too long; use a larger --cell-size
+static const uint32_t MAX_CELLS_PER_AXIS = 512;
+static const unsigned int MAX_LEAF_TRIANGLES = 4;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+struct SceneObject {
+    std::string path;
+    glm::mat4 transform;
+    glm::vec3 boxMin, boxMax;
+};
+
+struct Triangle {
+    glm::vec3 v0, v1, v2;
+    uint32_t object;
+};
+
+static bool LoadScene(const char *path, std::vector<SceneObject> &objects) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (getline(file, line)) {
+        std::istringstream lineStream(line.substr(0, line.find('#')));
+        std::string prefix;
+        if (!(lineStream >> prefix)) {
+            continue;
+        }
+        SceneObject object;
+        glm::vec3 position;
+        float scale;
+        lineStream >> object.path >> position.x >> position.y >> position.z >> scale;
+        bool valid = prefix == "model" && !lineStream.fail();
+        object.transform = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(scale));
+        std::string keyword, axis;
+        float degrees;
+        while (valid && lineStream >> keyword) {
+            lineStream >> axis >> degrees;
+            valid = keyword == "rotate" && !lineStream.fail() && (axis == "x" || axis == "y" || axis == "z");
+            if (valid) {
+                glm::vec3 rotationAxis(axis == "x" ? 1.0f : 0.0f, axis == "y" ? 1.0f : 0.0f, axis == "z" ? 1.0f : 0.0f);
+                object.transform = glm::rotate(object.transform, glm::radians(degrees), rotationAxis);
+            }
+        }
+        if (!valid) {
+            std::cerr << "Error: " << path << ": expected 'model <path> <x> <y> <z> <scale> [rotate <axis> <degrees>]...', got '"
+                      << line << "'" << std::endl;
+            return false;
+        }
+        objects.push_back(object);
+    }
+    return !objects.empty();
+}
+
+/**
+ * Median-split BVH over the scene's triangles, answering nearest-hit rays.
+ */
+class TriangleBVH {
+public:
+    explicit TriangleBVH(std::vector<Triangle> &triangles) : triangles(triangles) {
+        nodes.reserve(triangles.size() * 2 / MAX_LEAF_TRIANGLES + 1);
+        nodes.push_back(Node());
+        depth = 0;
+        Build(0, 0, static_cast<uint32_t>(triangles.size()), 0);
+    }
+
+    /**
+     * @return the object of the nearest triangle hit, or -1.
+     */
+    long Raycast(const glm::vec3 &origin, const glm::vec3 &direction) const {
+        glm::vec3 inverse = glm::vec3(1.0f) / direction;
+        float nearest = INFINITY;
+        long hitObject = -1;
+        // one pending sibling per level above the current node, plus its two children
+        thread_local std::vector<uint32_t> stack;
+        stack.resize(depth + 2);
+        size_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node &node = nodes[stack[--stackSize]];
+            if (!HitsBox(node, origin, inverse, nearest)) {
+                continue;
+            }
+            if (node.count > 0) {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+                    float t = IntersectTriangle(triangles[i], origin, direction);
+                    if (t < nearest) {
+                        nearest = t;
+                        hitObject = triangles[i].object;
+                    }
+                }
+            } else {
+                stack[stackSize++] = node.leftOrFirst;
+                stack[stackSize++] = node.leftOrFirst + 1;
+            }
+        }
+        return hitObject;
+    }
+
+private:
+    struct Node {
+        glm::vec3 boxMin;
+        uint32_t leftOrFirst;
+        glm::vec3 boxMax;
+        uint32_t count;
+    };
+
+    std::vector<Triangle> &triangles;
+    std::vector<Node> nodes;
+    // of the deepest leaf, the root being 0
+    uint32_t depth;
+
+    void Build(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t nodeDepth) {
+        depth = std::max(depth, nodeDepth);
+        glm::vec3 boxMin(INFINITY), boxMax(-INFINITY), centroidMin(INFINITY), centroidMax(-INFINITY);
+        for (uint32_t i = first; i < first + count; i++) {
+            const Triangle &triangle = triangles[i];
+            boxMin = glm::min(boxMin, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+            boxMax = glm::max(boxMax, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+            glm::vec3 centroid = (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f;
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+        nodes[nodeIndex].boxMin = boxMin;
+        nodes[nodeIndex].boxMax = boxMax;
+
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        if (count <= MAX_LEAF_TRIANGLES || extent[axis] <= 0.0f) {
+            nodes[nodeIndex].leftOrFirst = first;
+            nodes[nodeIndex].count = count;
+            return;
+        }
+
+        uint32_t half = count / 2;
+        std::nth_element(triangles.begin() + first, triangles.begin() + first + half, triangles.begin() + first + count,
+                         [axis](const Triangle &a, const Triangle &b) {
+                             return a.v0[axis] + a.v1[axis] + a.v2[axis] < b.v0[axis] + b.v1[axis] + b.v2[axis];
+                         });
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node());
+        nodes.push_back(Node());
+        nodes[nodeIndex].leftOrFirst = left;
+        nodes[nodeIndex].count = 0;
+        Build(left, first, half, nodeDepth + 1);
+        Build(left + 1, first + half, count - half, nodeDepth + 1);
+    }
+
+    static bool HitsBox(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverse, float maxDistance) {
+        glm::vec3 t0 = (node.boxMin - origin) * inverse, t1 = (node.boxMax - origin) * inverse;
+        glm::vec3 nearT = glm::min(t0, t1), farT = glm::max(t0, t1);
+        float entry = std::max(std::max(nearT.x, nearT.y), std::max(nearT.z, 0.0f));
+        float exit = std::min(std::min(farT.x, farT.y), std::min(farT.z, maxDistance));
+        return entry <= exit;
+    }
+
+    // Moller-Trumbore; INFINITY on a miss
+    static float IntersectTriangle(const Triangle &triangle, const glm::vec3 &origin, const glm::vec3 &direction) {
+        glm::vec3 edge1 = triangle.v1 - triangle.v0, edge2 = triangle.v2 - triangle.v0;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::abs(determinant) < 1e-12f) {
+            return INFINITY;
+        }
+        float inverseDeterminant = 1.0f / determinant;
+        glm::vec3 s = origin - triangle.v0;
+        float u = glm::dot(s, p) * inverseDeterminant;
+        if (u < 0.0f || u > 1.0f) {
+            return INFINITY;
+        }
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverseDeterminant;
+        if (v < 0.0f || u + v > 1.0f) {
+            return INFINITY;
+        }
+        float t = glm::dot(edge2, q) * inverseDeterminant;
+        return t > 0.0f ? t : INFINITY;
+    }
+};
+
+/**
+ * Separating axis test between a triangle and a box (Akenine-Moller).
+ */
+static bool TriangleOverlapsBox(const glm::vec3 &center, const glm::vec3 &half, const Triangle &triangle) {
+    glm::vec3 v[3] = {triangle.v0 - center, triangle.v1 - center, triangle.v2 - center};
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = std::min(v[0][axis], std::min(v[1][axis], v[2][axis]));
+        float hi = std::max(v[0][axis], std::max(v[1][axis], v[2][axis]));
+        if (lo > half[axis] || hi < -half[axis]) {
+            return false;
+        }
+    }
+    glm::vec3 edges[3] = {v[1] - v[0], v[2] - v[1], v[0] - v[2]};
+    glm::vec3 normal = glm::cross(edges[0], edges[1]);
+    float normalRadius = glm::dot(half, glm::abs(normal));
+    if (std::abs(glm::dot(normal, v[0])) > normalRadius) {
+        return false;
+    }
+    for (const glm::vec3 &edge : edges) {
+        for (int axis = 0; axis < 3; axis++) {
+            glm::vec3 unit(0.0f);
+            unit[axis] = 1.0f;
+            glm::vec3 separating = glm::cross(unit, edge);
+            float p0 = glm::dot(v[0], separating), p1 = glm::dot(v[1], separating), p2 = glm::dot(v[2], separating);
+            float radius = glm::dot(half, glm::abs(separating));
+            if (std::min(p0, std::min(p1, p2)) > radius || std::max(p0, std::max(p1, p2)) < -radius) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    float cellSize = 1.0f;
+    int raysPerCell = 1024;
+    unsigned int threadCount = 0;
+    int dilate = 1;
+    std::string scenePath, outputPath;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cell-size") == 0 && i + 1 < argc) {
+            cellSize = static_cast<float>(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            raysPerCell = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = static_cast<unsigned int>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--dilate") == 0 && i + 1 < argc) {
+            dilate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (argv[i][0] != '-' && scenePath.empty()) {
+            scenePath = argv[i];
+        } else {
+            scenePath.clear();
+            break;
+        }
+    }
+    if (scenePath.empty() || cellSize <= 0.0f || raysPerCell < 0 || dilate < 0) {
+        std::cerr << "Usage: pvs-bake [--cell-size S] [--rays R] [--threads N] [--dilate D] [--output file.pvs] scene"
+                  << std::endl;
+        return 1;
+    }
+    if (outputPath.empty()) {
+        outputPath = std::filesystem::path(scenePath).replace_extension(".pvs").string();
+    }
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // load and place every model, as the viewer does before animating
+    auto loadStart = std::chrono::steady_clock::now();
+    std::vector<SceneObject> objects;
+    if (!LoadScene(scenePath.c_str(), objects)) {
+        std::cerr << "Error: could not read scene " << scenePath << std::endl;
+        return 1;
+    }
+    std::vector<Triangle> triangles;
+    glm::vec3 sceneMin(INFINITY), sceneMax(-INFINITY);
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        SceneObject &object = objects[i];
+        ObjData obj;
+        if (!ParseOBJ(object.path.c_str(), obj)) {
+            std::cerr << "Error: could not open " << object.path << std::endl;
+            return 1;
+        }
+        MeshData mesh;
+        BuildMeshData(obj, mesh);
+        object.boxMin = glm::vec3(INFINITY);
+        object.boxMax = glm::vec3(-INFINITY);
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            Triangle triangle;
+            triangle.v0 = glm::vec3(object.transform * glm::vec4(mesh.vertices[mesh.indices[t]].position, 1.0f));
+            triangle.v1 = glm::vec3(object.transform * glm::vec4(mesh.vertices[mesh.indices[t + 1]].position, 1.0f));
+            triangle.v2 = glm::vec3(object.transform * glm::vec4(mesh.vertices[mesh.indices[t + 2]].position, 1.0f));
+            triangle.object = i;
+            object.boxMin = glm::min(object.boxMin, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+            object.boxMax = glm::max(object.boxMax, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+            triangles.push_back(triangle);
+        }
+        sceneMin = glm::min(sceneMin, object.boxMin);
+        sceneMax = glm::max(sceneMax, object.boxMax);
+        std::cout << object.path << ": " << mesh.indices.size() / 3 << " triangles" << std::endl;
+    }
+    if (triangles.empty()) {
+        std::cerr << "Error: the scene has no triangles" << std::endl;
+        return 1;
+    }
+
+    // one cell of padding around the scene so the camera can stand outside it
+    glm::vec3 origin = sceneMin - glm::vec3(cellSize);
+    uint32_t dims[3];
+    for (int axis = 0; axis < 3; axis++) {
+        dims[axis] = static_cast<uint32_t>(std::ceil((sceneMax[axis] - sceneMin[axis]) / cellSize)) + 2;
+        if (dims[axis] > MAX_CELLS_PER_AXIS) {
+            std::cerr << "Error: " << dims[axis] << " cells along axis " << axis << ", use a larger --cell-size" << std::endl;
+            return 1;
+        }
+    }
+    size_t cellCount = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+    auto cellMinOf = [&](size_t cell) {
+        size_t x = cell % dims[0], y = (cell / dims[0]) % dims[1], z = cell / (static_cast<size_t>(dims[0]) * dims[1]);
+        return origin + glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) * cellSize;
+    };
+
+    // voxelise: cells that touch geometry are solid, the rest are camera cells
+    auto voxelStart = std::chrono::steady_clock::now();
+    std::vector<unsigned char> solid(cellCount, 0);
+    glm::vec3 half(cellSize * 0.5f);
+    for (const Triangle &triangle : triangles) {
+        glm::vec3 lo = (glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)) - origin) / cellSize;
+        glm::vec3 hi = (glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)) - origin) / cellSize;
+        for (uint32_t z = static_cast<uint32_t>(lo.z); z <= std::min(static_cast<uint32_t>(hi.z), dims[2] - 1); z++) {
+            for (uint32_t y = static_cast<uint32_t>(lo.y); y <= std::min(static_cast<uint32_t>(hi.y), dims[1] - 1); y++) {
+                for (uint32_t x = static_cast<uint32_t>(lo.x); x <= std::min(static_cast<uint32_t>(hi.x), dims[0] - 1); x++) {
+                    size_t cell = (static_cast<size_t>(z) * dims[1] + y) * dims[0] + x;
+                    if (!solid[cell] && TriangleOverlapsBox(cellMinOf(cell) + half, half, triangle)) {
+                        solid[cell] = 1;
+                    }
+                }
+            }
+        }
+    }
+    size_t emptyCells = std::count(solid.begin(), solid.end(), 0);
+    auto voxelEnd = std::chrono::steady_clock::now();
+    std::cout << "Grid " << dims[0] << "x" << dims[1] << "x" << dims[2] << " of " << cellSize << " units: "
+              << emptyCells << " camera cells, " << cellCount - emptyCells << " solid ("
+              << ElapsedMs(voxelStart, voxelEnd) << " ms)" << std::endl;
+
+    TriangleBVH bvh(triangles);
+    auto bvhEnd = std::chrono::steady_clock::now();
+    std::cout << "Triangle BVH over " << triangles.size() << " triangles (" << ElapsedMs(voxelEnd, bvhEnd) << " ms)" << std::endl;
+
+    PotentiallyVisibleSet pvs;
+    pvs.Create(origin, cellSize, dims, static_cast<uint32_t>(objects.size()));
+
+    // each worker takes whole cells, so no two threads write the same row
+    std::atomic<size_t> nextCell(0);
+    auto sampleCells = [&]() {
+        std::normal_distribution<float> gaussian(0.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (size_t cell = nextCell++; cell < cellCount; cell = nextCell++) {
+            if (solid[cell]) {
+                // the camera can clip into geometry; hide nothing there
+                pvs.SetAllVisible(cell);
+                continue;
+            }
+            glm::vec3 cellMin = cellMinOf(cell);
+            // whatever is next to the cell counts as seen, however thin
+            for (uint32_t i = 0; i < objects.size(); i++) {
+                glm::vec3 nearMin = cellMin - glm::vec3(cellSize), nearMax = cellMin + glm::vec3(cellSize * 2.0f);
+                const SceneObject &object = objects[i];
+                if (object.boxMin.x <= nearMax.x && object.boxMin.y <= nearMax.y && object.boxMin.z <= nearMax.z &&
+                    object.boxMax.x >= nearMin.x && object.boxMax.y >= nearMin.y && object.boxMax.z >= nearMin.z) {
+                    pvs.SetVisible(cell, i);
+                }
+            }
+            std::mt19937 random(static_cast<unsigned int>(cell * 2654435761u));
+            for (int r = 0; r < raysPerCell; r++) {
+                glm::vec3 rayOrigin = cellMin + glm::vec3(unit(random), unit(random), unit(random)) * cellSize;
+                glm::vec3 direction(gaussian(random), gaussian(random), gaussian(random));
+                if (glm::dot(direction, direction) < 1e-12f) {
+                    continue;
+                }
+                long hit = bvh.Raycast(rayOrigin, glm::normalize(direction));
+                if (hit >= 0) {
+                    pvs.SetVisible(cell, static_cast<uint32_t>(hit));
+                }
+            }
+        }
+    };
+    auto raysStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < threadCount; t++) {
+        workers.emplace_back(sampleCells);
+    }
+    sampleCells();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    auto raysEnd = std::chrono::steady_clock::now();
+    double rayMs = ElapsedMs(raysStart, raysEnd);
+    std::cout << "Sampled " << raysPerCell << " rays per camera cell on " << threadCount << " threads: "
+              << static_cast<double>(emptyCells) * raysPerCell / (rayMs / 1000.0) << " rays/s (" << rayMs << " ms)" << std::endl;
+
+    // rays miss things between samples; widen each camera cell's set by its camera-cell neighbours
+    if (dilate > 0) {
+        PotentiallyVisibleSet sampled = pvs;
+        for (size_t cell = 0; cell < cellCount; cell++) {
+            if (solid[cell]) {
+                continue;
+            }
+            long x = static_cast<long>(cell % dims[0]), y = static_cast<long>((cell / dims[0]) % dims[1]);
+            long z = static_cast<long>(cell / (static_cast<size_t>(dims[0]) * dims[1]));
+            for (long dz = std::max(0L, z - dilate); dz <= std::min<long>(dims[2] - 1, z + dilate); dz++) {
+                for (long dy = std::max(0L, y - dilate); dy <= std::min<long>(dims[1] - 1, y + dilate); dy++) {
+                    for (long dx = std::max(0L, x - dilate); dx <= std::min<long>(dims[0] - 1, x + dilate); dx++) {
+                        size_t neighbour = pvs.GetCellIndex(static_cast<uint32_t>(dx), static_cast<uint32_t>(dy), static_cast<uint32_t>(dz));
+                        if (!solid[neighbour]) {
+                            pvs.Merge(cell, sampled, neighbour);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    size_t visibleTotal = 0;
+    for (size_t cell = 0; cell < cellCount; cell++) {
+        for (uint32_t i = 0; !solid[cell] && i < objects.size(); i++) {
+            visibleTotal += pvs.IsVisible(cell, i);
+        }
+    }
+    if (!pvs.Write(outputPath.c_str())) {
+        std::cerr << "Error: could not write " << outputPath << std::endl;
+        return 1;
+    }
+    PotentiallyVisibleSet written;
+    written.Load(outputPath.c_str(), static_cast<uint32_t>(objects.size()));
+    std::error_code error;
+    std::cout << "Average " << (emptyCells > 0 ? static_cast<double>(visibleTotal) / emptyCells : 0.0) << " of "
+              << objects.size() << " objects visible per camera cell, " << written.GetRowCount()
+              << " distinct sets, " << std::filesystem::file_size(outputPath, error) << " bytes written to "
+              << outputPath << " (total " << ElapsedMs(loadStart, std::chrono::steady_clock::now()) << " ms)" << std::endl;
+    return 0;
+}